@@ -0,0 +1,86 @@
+/**
+ * Multi-threaded call throughput
+ * N C++ threads call python functions through cppy3::Function handles.
+ * With GIL calls serialize, free-threaded python (python3.13t) is expected to scale with threads.
+ */
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <cppy3/cppy3.hpp>
+
+/** @return calls per second made by @b threads threads, each doing @b calls calls of @b name(arg) */
+double measure(const char *name, long arg, size_t threads, size_t calls)
+{
+  const size_t batch = 1000;
+  std::vector<std::thread> workers;
+  const auto start = std::chrono::steady_clock::now();
+  {
+    cppy3::ScopedGILRelease release;
+    for (size_t t = 0; t < threads; ++t)
+    {
+      workers.emplace_back([name, arg, calls, batch]()
+      {
+        for (size_t done = 0; done < calls; done += batch)
+        {
+          // attach per batch, lets other threads interleave when there is GIL
+          cppy3::GILLocker lock;
+          cppy3::Function f(name);
+          for (size_t i = 0; i < batch; ++i)
+          {
+            f(arg);
+          }
+        }
+      });
+    }
+    for (auto &w : workers)
+    {
+      w.join();
+    }
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return threads * calls / elapsed.count();
+}
+
+void run(const char *title, const char *name, long arg, size_t calls, size_t maxThreads)
+{
+  std::cout << title << std::endl;
+  std::cout << std::setw(8) << "threads" << std::setw(16) << "calls/s" << std::setw(10) << "speedup" << std::endl;
+  double single = 0;
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    const double rate = measure(name, arg, threads, calls);
+    if (threads == 1)
+    {
+      single = rate;
+    }
+    std::cout << std::setw(8) << threads << std::setw(16) << std::fixed << std::setprecision(0) << rate
+              << std::setw(9) << std::setprecision(2) << rate / single << "x" << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+int main()
+{
+  cppy3::PythonVM vm;
+  cppy3::exec(
+      "def rule(x):\n"
+      "  return x * 2 + 1\n"
+      "def work(n):\n"
+      "  s = 0\n"
+      "  for i in range(n):\n"
+      "    s += i * i\n"
+      "  return s\n");
+
+  const size_t maxThreads = std::max(4u, std::thread::hardware_concurrency());
+  std::cout << "python " << Py_GetVersion() << std::endl
+            << "free-threaded: " << (CPPY3_FREE_THREADED ? "yes" : "no") << std::endl
+            << std::endl;
+
+  run("tiny function, call overhead", "rule", 1, 200000, maxThreads);
+  run("cpu-bound function, work(200)", "work", 200, 10000, maxThreads);
+  return 0;
+}
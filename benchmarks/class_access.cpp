@@ -0,0 +1,63 @@
+/**
+ * Attribute access on exported C++ class against plain python classes
+ * with instance __dict__ and with __slots__
+ */
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <cppy3/cppy3.hpp>
+#include <cppy3/cppy3_class.hpp>
+
+struct Quote
+{
+  double bid = 0;
+  double ask = 0;
+  long size = 0;
+};
+
+/** @return ns per iteration of python @b expression repeated in a loop */
+double measure(const std::string &expression, size_t iterations)
+{
+  cppy3::exec("def run(n):\n  for i in range(n):\n    " + expression + "\n");
+  const auto start = std::chrono::steady_clock::now();
+  cppy3::vectorcall(cppy3::lookupCallable(cppy3::getMainModule(), "run"), long(iterations));
+  const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+int main()
+{
+  cppy3::PythonVM vm;
+  const cppy3::Class<Quote> quote = cppy3::Class<Quote>("Quote")
+                                        .field("bid", &Quote::bid)
+                                        .field("ask", &Quote::ask)
+                                        .field("size", &Quote::size);
+  cppy3::Module("exported").type(quote).install();
+
+  Quote q;
+  q.bid = 1.25;
+  q.ask = 1.5;
+  cppy3::Main().inject("viewed", quote.view(q));
+  cppy3::exec("import exported\n"
+              "owned = exported.Quote(bid=1.25, ask=1.5)\n"
+              "class DictQuote:\n"
+              "  def __init__(self): self.bid, self.ask, self.size = 1.25, 1.5, 0\n"
+              "class SlotsQuote:\n"
+              "  __slots__ = ('bid', 'ask', 'size')\n"
+              "  def __init__(self): self.bid, self.ask, self.size = 1.25, 1.5, 0\n"
+              "d = DictQuote()\n"
+              "s = SlotsQuote()\n");
+
+  const size_t iterations = 2000000;
+  std::cout << "python " << Py_GetVersion() << std::endl << std::endl;
+  std::cout << std::setw(34) << "" << std::setw(12) << "ns/iter" << std::endl << std::fixed << std::setprecision(1);
+  std::cout << std::setw(34) << "empty loop" << std::setw(12) << measure("pass", iterations) << std::endl;
+  for (const char *name : {"d", "s", "owned", "viewed"})
+  {
+    const std::string o(name);
+    std::cout << std::setw(34) << o + ".ask - " + o + ".bid" << std::setw(12) << measure(o + ".ask - " + o + ".bid", iterations) << std::endl;
+    std::cout << std::setw(34) << o + ".size = i" << std::setw(12) << measure(o + ".size = i", iterations) << std::endl;
+  }
+  return 0;
+}
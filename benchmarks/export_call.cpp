@@ -0,0 +1,61 @@
+/**
+ * Python -> C++ call overhead
+ * Hand-written METH_VARARGS | METH_KEYWORDS function parsing format string
+ * against the same function exported with cppy3::Module (METH_FASTCALL | METH_KEYWORDS)
+ */
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <cppy3/cppy3.hpp>
+#include <cppy3/cppy3_module.hpp>
+
+static PyObject *legacyAdd(PyObject * /* self */, PyObject *args, PyObject *keywds)
+{
+  long a = 0;
+  double b = 0;
+  static char *kwlist[] = {(char *)"a", (char *)"b", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "ld", kwlist, &a, &b))
+  {
+    return NULL;
+  }
+  return PyFloat_FromDouble(a + b);
+}
+
+static PyMethodDef legacyMethods[] = {
+    {"add", (PyCFunction)(void (*)(void))legacyAdd, METH_VARARGS | METH_KEYWORDS, NULL},
+    {NULL, NULL, 0, NULL}};
+
+static PyModuleDef legacyModule = {PyModuleDef_HEAD_INIT, "legacy", NULL, -1, legacyMethods, NULL, NULL, NULL, NULL};
+
+static PyObject *PyInit_legacy(void)
+{
+  return PyModule_Create(&legacyModule);
+}
+
+/** @return ns per call of python @b expression repeated in a loop */
+double measure(const std::string &expression, size_t calls)
+{
+  cppy3::exec("def run(n):\n  for i in range(n):\n    " + expression + "\n");
+  const auto start = std::chrono::steady_clock::now();
+  cppy3::vectorcall(cppy3::lookupCallable(cppy3::getMainModule(), "run"), long(calls));
+  const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / calls;
+}
+
+int main()
+{
+  cppy3::PythonVM vm("legacy", PyInit_legacy);
+  cppy3::Module("exported").def("add", [](long a, double b) { return a + b; }, {"a", "b"}).install();
+  cppy3::exec("import legacy, exported");
+
+  const size_t calls = 2000000;
+  std::cout << "python " << Py_GetVersion() << std::endl << std::endl;
+  std::cout << std::setw(34) << "" << std::setw(12) << "ns/call" << std::endl << std::fixed << std::setprecision(1);
+  std::cout << std::setw(34) << "empty loop" << std::setw(12) << measure("pass", calls) << std::endl;
+  std::cout << std::setw(34) << "PyArg_ParseTuple add(i, 0.5)" << std::setw(12) << measure("legacy.add(i, 0.5)", calls) << std::endl;
+  std::cout << std::setw(34) << "cppy3::Module add(i, 0.5)" << std::setw(12) << measure("exported.add(i, 0.5)", calls) << std::endl;
+  std::cout << std::setw(34) << "PyArg_ParseTuple add(a=i, b=0.5)" << std::setw(12) << measure("legacy.add(a=i, b=0.5)", calls) << std::endl;
+  std::cout << std::setw(34) << "cppy3::Module add(a=i, b=0.5)" << std::setw(12) << measure("exported.add(a=i, b=0.5)", calls) << std::endl;
+  return 0;
+}
@@ -0,0 +1,49 @@
+/**
+ * GIL acquisition latency from a thread not created by python
+ * GILLocker alone allocates PyThreadState per lock, under ThreadAttachment it only swaps the GIL.
+ */
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <cppy3/cppy3.hpp>
+
+/** @return average nanoseconds per GILLocker lock/unlock made on a fresh thread */
+double measure(bool attached, size_t locks)
+{
+  double elapsed = 0;
+  cppy3::ScopedGILRelease release;
+  std::thread worker([attached, locks, &elapsed]()
+  {
+    std::unique_ptr<cppy3::ThreadAttachment> attachment;
+    if (attached)
+    {
+      attachment.reset(new cppy3::ThreadAttachment());
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < locks; ++i)
+    {
+      cppy3::GILLocker lock;
+    }
+    const std::chrono::duration<double, std::nano> duration = std::chrono::steady_clock::now() - start;
+    elapsed = duration.count();
+  });
+  worker.join();
+  return elapsed / locks;
+}
+
+int main()
+{
+  cppy3::PythonVM vm;
+  const size_t locks = 1000000;
+
+  std::cout << "python " << Py_GetVersion() << std::endl << std::endl;
+  std::cout << std::setw(20) << "" << std::setw(12) << "ns/lock" << std::endl;
+  std::cout << std::setw(20) << "PyGILState" << std::setw(12) << std::fixed << std::setprecision(1)
+            << measure(false, locks) << std::endl;
+  std::cout << std::setw(20) << "ThreadAttachment" << std::setw(12) << std::fixed << std::setprecision(1)
+            << measure(true, locks) << std::endl;
+  return 0;
+}
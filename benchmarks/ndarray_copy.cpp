@@ -0,0 +1,81 @@
+/**
+ * NDArray copy throughput in GB/s, 100MB frame of doubles:
+ * element-wise PyArray_GETPTR2 loops (former NDArray::copy) against bulk / tiled / parallel copies
+ */
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <cppy3/cppy3.hpp>
+#include <cppy3/cppy3_numpy.hpp>
+
+const size_t ROWS = 3200;
+const size_t COLS = 4096;
+
+/** @return best GB/s of @b copy moving @b bytes */
+double measure(const std::function<void()> &copy, size_t bytes)
+{
+  double best = 0;
+  for (int i = 0; i < 5; ++i)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    copy();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::max(best, bytes / elapsed.count() / 1e9);
+  }
+  return best;
+}
+
+void report(const std::string &name, double gbs)
+{
+  std::cout << std::setw(48) << name << std::setw(10) << gbs << std::endl;
+}
+
+int main()
+{
+  cppy3::PythonVM vm;
+  cppy3::importNumpy();
+
+  std::vector<double> frame(ROWS * COLS);
+  for (size_t i = 0; i < frame.size(); ++i)
+  {
+    frame[i] = double(i);
+  }
+  std::vector<double> out(frame.size());
+  const size_t bytes = frame.size() * sizeof(double);
+
+  cppy3::NDArray<double> array;
+  cppy3::NDArray<double> source(frame.data(), {ROWS, COLS});
+  cppy3::Main().inject("source", source);
+  cppy3::NDArray<double> transposed(cppy3::eval("source.T"));
+
+  std::cout << "frame " << bytes / 1000000 << " MB" << std::endl << std::endl;
+  std::cout << std::setw(48) << "" << std::setw(10) << "GB/s" << std::endl << std::fixed << std::setprecision(2);
+
+  report("copy in, PyArray_GETPTR2 loop", measure([&]() {
+           array.create(ROWS, COLS);
+           for (size_t r = 0; r < ROWS; ++r)
+             for (size_t c = 0; c < COLS; ++c)
+               *(double *)PyArray_GETPTR2((PyArrayObject *)array, r, c) = frame[r * COLS + c];
+         }, bytes));
+  report("copy in, NDArray::copy", measure([&]() { array.copy(frame.data(), {ROWS, COLS}); }, bytes));
+
+  report("copy out transposed, PyArray_GETPTR2 loop", measure([&]() {
+           for (size_t r = 0; r < COLS; ++r)
+             for (size_t c = 0; c < ROWS; ++c)
+               out[r * ROWS + c] = *(double *)PyArray_GETPTR2((PyArrayObject *)transposed, r, c);
+         }, bytes));
+  report("copy out transposed, NDArray::copyTo", measure([&]() { transposed.copyTo(out.data()); }, bytes));
+  report("copy out, NDArray::copyTo", measure([&]() { source.copyTo(out.data()); }, bytes));
+
+  for (unsigned threads : {2, 4})
+  {
+    cppy3::setCopyThreads(threads);
+    const std::string suffix = ", " + std::to_string(threads) + " threads";
+    report("copy in, NDArray::copy" + suffix, measure([&]() { array.copy(frame.data(), {ROWS, COLS}); }, bytes));
+    report("copy out transposed, NDArray::copyTo" + suffix, measure([&]() { transposed.copyTo(out.data()); }, bytes));
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * Frames per second handed to python and dropped there, system allocator against BufferPool,
+ * for frame sizes below and above the huge page threshold
+ */
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include <cppy3/cppy3.hpp>
+#include <cppy3/cppy3_numpy.hpp>
+#include <cppy3/cppy3_pool.hpp>
+
+const int FRAMES = 5000;
+
+/** @return frames per second of creating, filling and dropping @b rows x @b cols frames */
+double measure(size_t rows, size_t cols)
+{
+  cppy3::Main main;
+  double best = 0;
+  for (int i = 0; i < 3; ++i)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; ++f)
+    {
+      cppy3::NDArray<float> frame;
+      frame.create({npy_intp(rows), npy_intp(cols)});
+      // touch every page as producer writing the frame does
+      for (size_t r = 0; r < rows; ++r)
+      {
+        frame(r, 0) = float(f);
+      }
+      main.inject("frame", frame);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::max(best, FRAMES / elapsed.count());
+  }
+  return best;
+}
+
+int main()
+{
+  cppy3::PythonVM vm;
+  cppy3::importNumpy();
+
+  std::cout << std::setw(24) << "frame" << std::setw(14) << "system" << std::setw(14) << "pool" << std::setw(14) << "reuse"
+            << std::endl
+            << std::fixed << std::setprecision(0);
+  for (size_t rows : {64, 1024, 8192})
+  {
+    const size_t cols = 256;
+    cppy3::setNDArrayPool(nullptr);
+    const double system = measure(rows, cols);
+
+    const std::shared_ptr<cppy3::BufferPool> pool = std::make_shared<cppy3::BufferPool>();
+    cppy3::setNDArrayPool(pool);
+    const double pooled = measure(rows, cols);
+    cppy3::setNDArrayPool(nullptr);
+
+    const std::string frame = std::to_string(rows) + "x" + std::to_string(cols) + " float32";
+    std::cout << std::setw(24) << frame << std::setw(14) << system << std::setw(14) << pooled << std::setw(13) << std::setprecision(1)
+              << pool->stats().reuseRate() * 100 << "%" << std::setprecision(0) << std::endl;
+  }
+  return 0;
+}
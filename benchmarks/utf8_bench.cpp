@@ -0,0 +1,96 @@
+/**
+ * Throughput of UTF-8 <-> wchar_t converters
+ * compares cppy3 transcoder with former locale based mbsrtowcs / wcstombs implementation
+ */
+#include <chrono>
+#include <clocale>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <cppy3/utils.hpp>
+
+namespace legacy
+{
+  std::wstring UTF8ToWide(const std::string &text)
+  {
+    std::mbstate_t state{};
+    const char *narrow = text.c_str();
+    std::size_t len = std::strlen(narrow) * 2;
+    wchar_t *wide = (wchar_t *)malloc(sizeof(wchar_t) * (len + 1));
+    std::mbsrtowcs(wide, &narrow, len, &state);
+    std::wstring result(wide);
+    free(wide);
+    return result;
+  }
+
+  std::string WideToUTF8(const std::wstring &text)
+  {
+    const wchar_t *wide = text.c_str();
+    std::size_t len = text.size() * 2;
+    char *narrow = (char *)malloc(sizeof(char) * (len + 1));
+    std::wcstombs(narrow, wide, len);
+    std::string result(narrow);
+    free(narrow);
+    return result;
+  }
+}
+
+template <typename F>
+double measure(F f, size_t bytes, size_t iterations)
+{
+  const auto start = std::chrono::steady_clock::now();
+  size_t sink = 0;
+  for (size_t i = 0; i < iterations; ++i)
+  {
+    sink += f().size();
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  if (sink == 0)
+  {
+    std::cerr << "unexpected empty result" << std::endl;
+  }
+  return bytes * iterations / elapsed.count() / (1 << 20);
+}
+
+void run(const char *name, const std::string &utf8, size_t iterations)
+{
+  const std::wstring wide = cppy3::UTF8ToWide(utf8);
+  if (legacy::UTF8ToWide(utf8) != wide || legacy::WideToUTF8(wide) != utf8)
+  {
+    std::cerr << "legacy converter mismatch, check that UTF-8 locale is available" << std::endl;
+  }
+
+  const double legacyToWide = measure([&]() { return legacy::UTF8ToWide(utf8); }, utf8.size(), iterations);
+  const double toWide = measure([&]() { return cppy3::UTF8ToWide(utf8); }, utf8.size(), iterations);
+  const double legacyToUTF8 = measure([&]() { return legacy::WideToUTF8(wide); }, utf8.size(), iterations);
+  const double toUTF8 = measure([&]() { return cppy3::WideToUTF8(wide); }, utf8.size(), iterations);
+
+  std::cout << name << " (" << utf8.size() << " bytes)" << std::endl
+            << "  UTF8ToWide  legacy " << legacyToWide << " MB/s, cppy3 " << toWide << " MB/s, x" << toWide / legacyToWide << std::endl
+            << "  WideToUTF8  legacy " << legacyToUTF8 << " MB/s, cppy3 " << toUTF8 << " MB/s, x" << toUTF8 / legacyToUTF8 << std::endl;
+}
+
+int main()
+{
+  // legacy converters depend on process locale
+  if (!std::setlocale(LC_ALL, "C.UTF-8") && !std::setlocale(LC_ALL, "en_US.UTF-8"))
+  {
+    std::cerr << "no UTF-8 locale, legacy numbers are not meaningful" << std::endl;
+  }
+
+  std::string identifier = "module.submodule.function_name";
+  std::string ascii;
+  std::string cyrillic;
+  for (int i = 0; i < 64; ++i)
+  {
+    ascii += "Traceback (most recent call last): File \"<string>\", line 1, in <module>\n";
+    cyrillic += "\xd0\xb7\xd0\xb0\xd1\x87\xd0\xb5\xd0\xbc \xd0\xb2\xd1\x8b \xd0\xbf\xd0\xbe\xd1\x81\xd0\xb5\xd1\x82\xd0\xb8\xd0\xbb\xd0\xb8 \xd0\xbd\xd0\xb0\xd1\x81 ";
+  }
+
+  run("short identifier", identifier, 2000000);
+  run("ascii text", ascii, 20000);
+  run("cyrillic text", cyrillic, 20000);
+  return 0;
+}
@@ -1,11 +1,16 @@
 #include "cppy3.hpp"
 
+#include <atomic>
 #include <cassert>
+#include <climits>
 #include <cstdlib>
+#include <functional>
 #include <sstream>
 #include <iostream>
 #include <fstream>
 #include <streambuf>
+#include <string_view>
+#include <unordered_map>
 
 #include "utils.hpp"
 
@@ -25,6 +30,286 @@ int setenv(const char *name, const char *value, int overwrite)
 namespace cppy3
 {
 
+  namespace
+  {
+    /** bumped every time per-interpreter storage is destroyed, invalidates per-thread lookups */
+    std::atomic<unsigned long> interpreterEpoch(0);
+
+    /** bumped on main interpreter shutdown, invalidates thread states kept by ThreadAttachment */
+    std::atomic<unsigned long> vmGeneration(0);
+
+    struct AttachedThread
+    {
+      PyThreadState *state;
+      unsigned long generation;
+    };
+    thread_local AttachedThread attachedThread = {NULL, 0};
+
+    template <typename T>
+    void destroyInterpreterLocal(PyObject *capsule)
+    {
+      delete static_cast<T *>(PyCapsule_GetPointer(capsule, PyCapsule_GetName(capsule)));
+      ++interpreterEpoch;
+    }
+
+    /**
+     * Per-interpreter instance of T kept in PyInterpreterState_GetDict() under @b key.
+     * Destroyed together with interpreter (Py_Finalize / Py_EndInterpreter),
+     * so nothing survives interpreter restart. GIL required.
+     */
+    template <typename T>
+    T *interpreterLocal(const char *key)
+    {
+      struct Slot
+      {
+        PyInterpreterState *interp;
+        unsigned long epoch;
+        T *value;
+      };
+      static thread_local Slot slot = {NULL, 0, NULL};
+
+      PyInterpreterState *interp = currentInterpreter();
+      const unsigned long epoch = interpreterEpoch.load();
+      if (slot.value && slot.interp == interp && slot.epoch == epoch)
+      {
+        return slot.value;
+      }
+
+      PyObject *dict = PyInterpreterState_GetDict(interp);
+      assert(dict);
+      T *value = NULL;
+      // threads of free-threaded build race to create the value
+      CriticalSection lock(dict);
+      const Var capsule = Var::from(dictItem(dict, key));
+      if (!capsule.null())
+      {
+        value = static_cast<T *>(PyCapsule_GetPointer(capsule, key));
+      }
+      else
+      {
+        value = new T();
+        Var holder = Var::from(PyCapsule_New(value, key, &destroyInterpreterLocal<T>));
+        const int r = PyDict_SetItemString(dict, key, holder);
+        assert(r == 0);
+        (void)r;
+      }
+      slot = {interp, epoch, value};
+      return value;
+    }
+
+    /**
+     * Lock for C++ state shared by threads of free-threaded build, no-op with GIL.
+     * PyMutex detaches thread state while blocked, so waiting does not stall stop-the-world pauses
+     */
+    class Mutex
+    {
+    public:
+#if CPPY3_FREE_THREADED
+      Mutex() : _mutex() {}
+      void lock() { PyMutex_Lock(&_mutex); }
+      void unlock() { PyMutex_Unlock(&_mutex); }
+
+    private:
+      PyMutex _mutex;
+#else
+      void lock() {}
+      void unlock() {}
+#endif
+    };
+
+    /**
+     * LRU cache of compiled code objects
+     */
+    class CodeCache
+    {
+    public:
+      CodeCache() : _capacity(256), _hits(0), _misses(0), _evictions(0) {}
+
+      /**
+       * @return new reference to code object compiled from @b source in @b mode
+       * or NULL with python error set if compilation failed.
+       * Py_eval_input accepts statements too, @see compileSource()
+       */
+      PyObject *compile(const char *source, int mode)
+      {
+        const std::string_view text(source);
+        const size_t key = std::hash<std::string_view>()(text) ^ (size_t(mode) * 0x9e3779b97f4a7c15ULL);
+
+        {
+          std::lock_guard<Mutex> lock(_mutex);
+          auto found = _index.find(key);
+          if (found != _index.end())
+          {
+            Entry &entry = *found->second;
+            if (entry.mode == mode && entry.source == text)
+            {
+              ++_hits;
+              _entries.splice(_entries.begin(), _entries, found->second);
+              Py_INCREF(entry.code.data());
+              return entry.code.data();
+            }
+          }
+          ++_misses;
+        }
+
+        // compile unlocked, other thread may compile same source meanwhile
+        PyObject *code = compileSource(source, mode);
+        std::lock_guard<Mutex> lock(_mutex);
+        if (code == NULL || _capacity == 0)
+        {
+          return code;
+        }
+
+        auto found = _index.find(key);
+        if (found != _index.end())
+        {
+          // hash collision, reuse slot for the latest source
+          Entry &entry = *found->second;
+          entry.source.assign(text);
+          entry.mode = mode;
+          entry.code.reset(code);
+          _entries.splice(_entries.begin(), _entries, found->second);
+        }
+        else
+        {
+          _entries.emplace_front();
+          Entry &entry = _entries.front();
+          entry.key = key;
+          entry.source.assign(text);
+          entry.mode = mode;
+          entry.code.reset(code);
+          _index[key] = _entries.begin();
+          shrink(_capacity);
+        }
+        return code;
+      }
+
+      void setCapacity(size_t capacity)
+      {
+        std::lock_guard<Mutex> lock(_mutex);
+        _capacity = capacity;
+        shrink(_capacity);
+      }
+
+      void clear()
+      {
+        std::lock_guard<Mutex> lock(_mutex);
+        shrink(0);
+      }
+
+      CodeCacheStats stats()
+      {
+        std::lock_guard<Mutex> lock(_mutex);
+        return CodeCacheStats{_hits, _misses, _evictions, _entries.size(), _capacity};
+      }
+
+    private:
+      /**
+       * Py_eval_input source is parsed once and compiled as expression or, if it is not one, as statements,
+       * so statements cost no failed compile nor SyntaxError. Cache keeps the resulting code
+       */
+      static PyObject *compileSource(const char *source, int mode)
+      {
+        if (mode != Py_eval_input)
+        {
+          return Py_CompileString(source, "<string>", mode);
+        }
+        PyCompilerFlags flags = {PyCF_ONLY_AST, PY_MINOR_VERSION};
+        const Var tree = Var::from(Py_CompileStringFlags(source, "<string>", Py_file_input, &flags));
+        const Var ast = Var::from(tree.null() ? NULL : PyImport_ImportModule("_ast"));
+        const Var body = Var::from(tree.null() ? NULL : PyObject_GetAttrString(tree, "body"));
+        const Var compile = Var::from(dictItem(PyEval_GetBuiltins(), "compile"));
+        if (ast.null() || body.null() || compile.null())
+        {
+          return NULL;
+        }
+        const Var exprType = Var::from(PyObject_GetAttrString(ast, "Expr"));
+        if (exprType.null())
+        {
+          return NULL;
+        }
+        // single expression statement is compiled in eval mode to give its value
+        if (PyList_Check(body.data()) && PyList_GET_SIZE(body.data()) == 1 &&
+            PyObject_TypeCheck(PyList_GET_ITEM(body.data(), 0), reinterpret_cast<PyTypeObject *>(exprType.data())))
+        {
+          const Var value = Var::from(PyObject_GetAttrString(PyList_GET_ITEM(body.data(), 0), "value"));
+          const Var expressionType = Var::from(PyObject_GetAttrString(ast, "Expression"));
+          if (value.null() || expressionType.null())
+          {
+            return NULL;
+          }
+          const Var expression = Var::from(PyObject_CallFunctionObjArgs(expressionType, value.data(), NULL));
+          return expression.null() ? NULL : PyObject_CallFunction(compile, "Oss", expression.data(), "<string>", "eval");
+        }
+        return PyObject_CallFunction(compile, "Oss", tree.data(), "<string>", "exec");
+      }
+
+      struct Entry
+      {
+        size_t key;
+        std::string source;
+        int mode;
+        Var code;
+      };
+
+      void shrink(size_t capacity)
+      {
+        while (_entries.size() > capacity)
+        {
+          _index.erase(_entries.back().key);
+          _entries.pop_back();
+          ++_evictions;
+        }
+      }
+
+      Mutex _mutex;
+      std::list<Entry> _entries;
+      std::unordered_map<size_t, std::list<Entry>::iterator> _index;
+      size_t _capacity;
+      size_t _hits;
+      size_t _misses;
+      size_t _evictions;
+    };
+
+    CodeCache &codeCache()
+    {
+      return *interpreterLocal<CodeCache>("cppy3.CodeCache");
+    }
+
+    /** run compiled code in given namespace */
+    Var evalCode(PyObject *code, PyObject *globals, PyObject *locals)
+    {
+      Var result;
+      if (code)
+      {
+        result.newRef(PyEval_EvalCode(code, globals, locals));
+      }
+      if (result.data() == NULL)
+      {
+        rethrowPythonException();
+      }
+      return result;
+    }
+  }
+
+  LIB_API CodeCacheStats codeCacheStats()
+  {
+    GILLocker lock;
+    return codeCache().stats();
+  }
+
+  LIB_API void setCodeCacheCapacity(size_t capacity)
+  {
+    GILLocker lock;
+    codeCache().setCapacity(capacity);
+  }
+
+  LIB_API void clearCodeCache()
+  {
+    GILLocker lock;
+    codeCache().clear();
+  }
+
   PythonVM::PythonVM()
   {
 
@@ -49,8 +334,10 @@ namespace cppy3
     setenv("PYTHONIOENCODING", "UTF-8", 0);
 #endif
 
-    // register the module
-    PyImport_AppendInittab(name.c_str(), module);
+    // register the module, inittab keeps the name pointer for process lifetime
+    static std::list<std::string> names;
+    names.push_back(name);
+    PyImport_AppendInittab(names.back().c_str(), module);
 
     // create CPython instance without registering signal handlers
     Py_InitializeEx(0);
@@ -62,6 +349,8 @@ namespace cppy3
     {
       PyErr_Clear();
     }
+    // thread states of all threads are deleted by finalization
+    ++vmGeneration;
     Py_Finalize();
   }
 
@@ -82,6 +371,11 @@ namespace cppy3
   }
 
   Var createClassInstance(const std::wstring &callable)
+  {
+    return createClassInstance(WideToUTF8(callable));
+  }
+
+  Var createClassInstance(std::string_view callable)
   {
     GILLocker lock;
     Var instance;
@@ -90,22 +384,24 @@ namespace cppy3
     rethrowPythonException();
     if (instance.none())
     {
-      std::wstringstream ss;
-      ss << L"error instantiating '" << callable << "': " << getErrorObject().toString();
+      std::stringstream ss;
+      ss << "error instantiating '" << callable << "': " << WideToUTF8(getErrorObject().toString());
       throw PythonException(ss.str());
     }
     return instance;
   }
 
-  void appendToSysPath(const std::vector<std::wstring> &paths)
+  template <typename String>
+  static void appendToSysPathImpl(const std::vector<String> &paths)
   {
     GILLocker lock;
 
     Var sys = import("sys");
-    List sysPath(lookupObject(sys, L"path"));
-    for (auto path : paths)
+    List sysPath(lookupObject(sys, "path"));
+    CriticalSection pathLock(sysPath);
+    for (const String &path : paths)
     {
-      Var pyPath(convert(path));
+      const Var pyPath = Var::from(convert(path));
       if (!sysPath.contains(pyPath))
       {
         // append into the 'sys.path'
@@ -114,6 +410,16 @@ namespace cppy3
     }
   }
 
+  void appendToSysPath(const std::vector<std::wstring> &paths)
+  {
+    appendToSysPathImpl(paths);
+  }
+
+  void appendToSysPath(const std::vector<std::string> &paths)
+  {
+    appendToSysPathImpl(paths);
+  }
+
   void interrupt()
   {
     PyErr_SetInterrupt();
@@ -123,39 +429,17 @@ namespace cppy3
   {
     GILLocker lock;
     PyObject *mainDict = getMainDict();
-    Var result;
-
-    result.newRef(PyRun_String(pythonScript, Py_file_input, mainDict, mainDict));
-    if (result.data() == NULL)
-    {
-      rethrowPythonException();
-    }
-    return result;
+    const Var code = Var::from(codeCache().compile(pythonScript, Py_file_input));
+    return evalCode(code, mainDict, mainDict);
   }
 
   LIB_API Var eval(const char *pythonScript)
   {
     GILLocker lock;
     PyObject *mainDict = getMainDict();
-    Var result;
-
-    result.newRef(PyRun_String(pythonScript, Py_eval_input, mainDict, mainDict));
-    if (result.data() == NULL)
-    {
-      const PyExceptionData excData = getErrorObject(false);
-      if (excData.type == L"<class 'SyntaxError'>")
-      {
-        // eval() throws SyntaxError when called with expressions
-        // use exec() for expressions
-        getErrorObject(true);
-        return exec(pythonScript);
-      }
-      else
-      {
-        rethrowPythonException();
-      }
-    }
-    return result;
+    // statements are compiled in exec mode and give None
+    const Var code = Var::from(codeCache().compile(pythonScript, Py_eval_input));
+    return evalCode(code, mainDict, mainDict);
   }
 
   LIB_API Var exec(const std::string &pythonScript)
@@ -173,7 +457,7 @@ namespace cppy3
     return exec(WideToUTF8(script).c_str());
   }
 
-  LIB_API Var execScriptFile(const std::string &path)
+  static std::string readScriptFile(const std::string &path)
   {
     std::ifstream t(path);
 
@@ -182,11 +466,56 @@ namespace cppy3
       throw PythonException(L"cannot open file " + UTF8ToWide(path));
     }
 
-    std::string script((std::istreambuf_iterator<char>(t)),
+    return std::string((std::istreambuf_iterator<char>(t)),
                        std::istreambuf_iterator<char>());
+  }
+
+  LIB_API Var execScriptFile(const std::string &path)
+  {
+    const std::string script = readScriptFile(path);
     return exec(script.c_str());
   }
 
+  LIB_API Script::Script(const std::string &source, const std::string &filename, int mode)
+  {
+    GILLocker lock;
+    _code.newRef(Py_CompileString(source.c_str(), filename.c_str(), mode));
+    if (_code.null())
+    {
+      rethrowPythonException();
+    }
+  }
+
+  LIB_API Script::Script(const std::wstring &source, const std::string &filename, int mode)
+      : Script(WideToUTF8(source), filename, mode)
+  {
+  }
+
+  LIB_API Script Script::fromFile(const std::string &path)
+  {
+    return Script(readScriptFile(path), path);
+  }
+
+  LIB_API Var Script::exec() const
+  {
+    GILLocker lock;
+    PyObject *mainDict = getMainDict();
+    return evalCode(_code, mainDict, mainDict);
+  }
+
+  LIB_API Var Script::exec(PyObject *globals, PyObject *locals) const
+  {
+    assert(globals);
+    GILLocker lock;
+    // like python exec(), older interpreters give code without __builtins__ an empty builtins namespace
+    const Var builtins = Var::from(dictItem(globals, "__builtins__"));
+    if (builtins.null() && PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins()) != 0)
+    {
+      rethrowPythonException();
+    }
+    return evalCode(_code, globals, locals ? locals : globals);
+  }
+
   LIB_API bool error()
   {
     GILLocker lock;
@@ -207,90 +536,192 @@ namespace cppy3
     std::wstring result;
     if (PyUnicode_Check(object))
     {
-      PyObject *bytes = PyUnicode_AsEncodedString(object, "UTF-8", "strict"); // Owned reference
-      if (bytes != NULL)
+      // utf-8 representation is cached inside unicode object
+      Py_ssize_t size = 0;
+      const char *utf8String = PyUnicode_AsUTF8AndSize(object, &size);
+      if (utf8String != NULL)
       {
-        char *utf8String = PyBytes_AS_STRING(bytes); // Borrowed pointer
-        result = UTF8ToWide(std::string(utf8String));
-        Py_DECREF(bytes);
+        result = UTF8ToWide(utf8String, size);
+      }
+      else
+      {
+        PyErr_Clear();
       }
     }
     return result;
   }
 
-  LIB_API PyExceptionData getErrorObject(const bool clearError)
+  /** @return str(o) or empty string, python error state untouched */
+  static std::wstring strOf(PyObject *o)
   {
-    GILLocker lock;
-    std::wstring exceptionType;
-    std::wstring exceptionMessage;
-    std::vector<std::wstring> exceptionTrace;
-    if (PyErr_Occurred())
-    {
-      // get error context
-      PyObject *excType = NULL;
-      PyObject *excValue = NULL;
-      PyObject *excTraceback = NULL;
-      PyErr_Fetch(&excType, &excValue, &excTraceback);
-      PyErr_NormalizeException(&excType, &excValue, &excTraceback);
-
-      // get traceback module
-      PyObject *name = PyUnicode_FromString("traceback");
-      PyObject *tracebackModule = PyImport_Import(name);
-      Py_DECREF(name);
-
-      // write text type of exception
-      exceptionType = pyUnicodeToWstring(PyObject_Str(excType));
-
-      // write text message of exception
-      exceptionMessage = pyUnicodeToWstring(PyObject_Str(excValue));
-
-      if (excTraceback != NULL && tracebackModule != NULL)
-      {
-        // get traceback.format_tb() function ptr
-        PyObject *tbDict = PyModule_GetDict(tracebackModule);
-        PyObject *format_tbFunc = PyDict_GetItemString(tbDict, "format_tb");
-        if (format_tbFunc && PyCallable_Check(format_tbFunc))
+    const Var str = Var::from(o ? PyObject_Str(o) : NULL);
+    if (str.null())
+    {
+      PyErr_Clear();
+      return std::wstring();
+    }
+    return pyUnicodeToWstring(str);
+  }
+
+  namespace
+  {
+    /** per-interpreter traceback.format_tb, imported on first use */
+    struct TracebackFormatter
+    {
+      Var formatTb;
+
+      std::vector<std::wstring> format(PyObject *traceback)
+      {
+        std::vector<std::wstring> lines;
+        if (formatTb.null())
         {
-          // build argument
-          PyObject *excTbTupleArg = PyTuple_New(1);
-          PyTuple_SetItem(excTbTupleArg, 0, excTraceback);
-          Py_INCREF(excTraceback); // because PyTuple_SetItem() steals reference
-          // call traceback.format_tb(excTraceback)
-          PyObject *list = PyObject_CallObject(format_tbFunc, excTbTupleArg);
-          if (list != NULL)
+          const Var module = Var::from(PyImport_ImportModule("traceback"));
+          if (!module.null())
           {
-            // parse list and extract traceback text lines
-            const int len = PyList_Size(list);
-            for (int i = 0; i < len; i++)
-            {
-              PyObject *tt = PyList_GetItem(list, i);
-              PyObject *t = Py_BuildValue("(O)", tt);
-              char *buffer = NULL;
-              if (PyArg_ParseTuple(t, "s", &buffer))
-              {
-                exceptionTrace.push_back(UTF8ToWide(buffer));
-              }
-              Py_XDECREF(t);
-            }
-            Py_DECREF(list);
+            formatTb.newRef(PyObject_GetAttrString(module, "format_tb"));
           }
-          Py_XDECREF(excTbTupleArg);
         }
+        const Var list = Var::from(formatTb.null() ? NULL : PyObject_CallFunctionObjArgs(formatTb, traceback, NULL));
+        if (list.null() || !PyList_Check(list))
+        {
+          PyErr_Clear();
+          return lines;
+        }
+        const Py_ssize_t size = PyList_GET_SIZE(list.data());
+        lines.reserve(size);
+        for (Py_ssize_t i = 0; i < size; ++i)
+        {
+          lines.push_back(pyUnicodeToWstring(PyList_GET_ITEM(list.data(), i)));
+        }
+        return lines;
       }
-      Py_XDECREF(tracebackModule);
+    };
+
+    TracebackFormatter &tracebackFormatter()
+    {
+      return *interpreterLocal<TracebackFormatter>("cppy3.TracebackFormatter");
+    }
 
-      if (clearError)
+    /** flag shared with objects that outlive interpreter, reset on its shutdown */
+    struct InterpreterLifetime
+    {
+      std::shared_ptr<std::atomic<bool>> alive;
+
+      InterpreterLifetime() : alive(std::make_shared<std::atomic<bool>>(true)) {}
+      ~InterpreterLifetime()
       {
-        Py_XDECREF(excType);
-        Py_XDECREF(excValue);
-        Py_XDECREF(excTraceback);
+        *alive = false;
       }
-      else
+    };
+  }
+
+  LIB_API std::shared_ptr<std::atomic<bool>> interpreterAlive()
+  {
+    return interpreterLocal<InterpreterLifetime>("cppy3.InterpreterLifetime")->alive;
+  }
+
+  struct TraceLines::State
+  {
+    PyObject *traceback;
+    /** lifetime of interpreter traceback belongs to */
+    std::shared_ptr<std::atomic<bool>> interpreter;
+    std::atomic<bool> formatted;
+    std::vector<std::wstring> lines;
+    Mutex mutex;
+
+    State() : traceback(NULL), formatted(false) {}
+
+    ~State()
+    {
+      if (traceback && alive())
+      {
+        GILLocker lock;
+        Py_DECREF(traceback);
+      }
+    }
+
+    /** traceback object is unusable once its interpreter has been shut down */
+    bool alive() const
+    {
+      return Py_IsInitialized() && interpreter && *interpreter;
+    }
+  };
+
+  LIB_API TraceLines::TraceLines(const std::vector<std::wstring> &lines) : _state(std::make_shared<State>())
+  {
+    _state->lines = lines;
+    _state->formatted = true;
+  }
+
+  LIB_API TraceLines::TraceLines(PyObject *traceback)
+  {
+    if (traceback)
+    {
+      _state = std::make_shared<State>();
+      _state->interpreter = interpreterAlive();
+      Py_INCREF(traceback);
+      _state->traceback = traceback;
+    }
+  }
+
+  LIB_API const std::vector<std::wstring> &TraceLines::lines() const
+  {
+    static const std::vector<std::wstring> noLines;
+    if (!_state)
+    {
+      return noLines;
+    }
+    State &state = *_state;
+    if (!state.formatted.load(std::memory_order_acquire) && state.alive())
+    {
+      GILLocker lock;
+      std::lock_guard<Mutex> formatting(state.mutex);
+      if (!state.formatted.load(std::memory_order_relaxed))
       {
+        // do not disturb python error being handled
+        PyObject *excType = NULL;
+        PyObject *excValue = NULL;
+        PyObject *excTraceback = NULL;
+        PyErr_Fetch(&excType, &excValue, &excTraceback);
+        state.lines = tracebackFormatter().format(state.traceback);
         PyErr_Restore(excType, excValue, excTraceback);
+
+        Py_CLEAR(state.traceback);
+        state.formatted.store(true, std::memory_order_release);
       }
     }
-    return PyExceptionData(exceptionType, exceptionMessage, exceptionTrace);
+    return state.lines;
+  }
+
+  LIB_API PyExceptionData getErrorObject(const bool clearError)
+  {
+    GILLocker lock;
+    if (!PyErr_Occurred())
+    {
+      return PyExceptionData();
+    }
+
+    // get error context
+    PyObject *excType = NULL;
+    PyObject *excValue = NULL;
+    PyObject *excTraceback = NULL;
+    PyErr_Fetch(&excType, &excValue, &excTraceback);
+    PyErr_NormalizeException(&excType, &excValue, &excTraceback);
+
+    // traceback is kept as object and formatted on demand
+    const PyExceptionData data(strOf(excType), strOf(excValue), TraceLines(excTraceback));
+
+    if (clearError)
+    {
+      Py_XDECREF(excType);
+      Py_XDECREF(excValue);
+      Py_XDECREF(excTraceback);
+    }
+    else
+    {
+      PyErr_Restore(excType, excValue, excTraceback);
+    }
+    return data;
   }
 
   LIB_API PyObject *convert(const int &value)
@@ -300,6 +731,19 @@ namespace cppy3
     return o;
   }
 
+  LIB_API PyObject *convert(const long &value)
+  {
+    PyObject *o = PyLong_FromLong(value);
+    assert(o);
+    return o;
+  }
+
+  LIB_API PyObject *convert(PyObject *value)
+  {
+    Py_XINCREF(value);
+    return value;
+  }
+
   LIB_API PyObject *convert(const double &value)
   {
     PyObject *o = PyFloat_FromDouble(value);
@@ -307,12 +751,188 @@ namespace cppy3
     return o;
   }
 
+  namespace
+  {
+    /**
+     * Buffer protocol exporter over C++ owned memory block
+     */
+    struct BufferObject
+    {
+      PyObject_HEAD
+      std::shared_ptr<void> owner;
+      void *data;
+      std::vector<Py_ssize_t> shape;
+      std::vector<Py_ssize_t> strides;
+      Py_ssize_t itemsize;
+      Py_ssize_t len;
+      const char *format;
+      bool readonly;
+      bool cContiguous;
+      bool fContiguous;
+    };
+
+    /** @return true when strides describe dense layout, last dimension varying fastest in C order */
+    bool denseStrides(const std::vector<Py_ssize_t> &shape, const std::vector<Py_ssize_t> &strides, Py_ssize_t itemsize, bool cOrder)
+    {
+      Py_ssize_t expected = itemsize;
+      for (size_t i = 0; i < shape.size(); ++i)
+      {
+        const size_t d = cOrder ? shape.size() - 1 - i : i;
+        if (shape[d] == 0)
+        {
+          return true;
+        }
+        if (shape[d] != 1 && strides[d] != expected)
+        {
+          return false;
+        }
+        expected *= shape[d];
+      }
+      return true;
+    }
+
+    int bufferGet(PyObject *self, Py_buffer *view, int flags)
+    {
+      BufferObject *b = reinterpret_cast<BufferObject *>(self);
+      if ((flags & PyBUF_WRITABLE) && b->readonly)
+      {
+        PyErr_SetString(PyExc_BufferError, "buffer is read-only");
+        return -1;
+      }
+      // consumers not taking strides assume C order
+      if (((flags & PyBUF_STRIDES) != PyBUF_STRIDES || (flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS) && !b->cContiguous)
+      {
+        PyErr_SetString(PyExc_BufferError, "buffer is not C-contiguous");
+        return -1;
+      }
+      if ((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS && !b->fContiguous)
+      {
+        PyErr_SetString(PyExc_BufferError, "buffer is not Fortran contiguous");
+        return -1;
+      }
+      if ((flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS && !b->cContiguous && !b->fContiguous)
+      {
+        PyErr_SetString(PyExc_BufferError, "buffer is not contiguous");
+        return -1;
+      }
+      Py_INCREF(self);
+      view->obj = self;
+      view->buf = b->data;
+      view->len = b->len;
+      view->readonly = b->readonly;
+      view->itemsize = b->itemsize;
+      view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(b->format) : NULL;
+      view->ndim = static_cast<int>(b->shape.size());
+      view->shape = (flags & PyBUF_ND) ? b->shape.data() : NULL;
+      view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? b->strides.data() : NULL;
+      view->suboffsets = NULL;
+      view->internal = NULL;
+      return 0;
+    }
+
+    void bufferDealloc(PyObject *self)
+    {
+      BufferObject *b = reinterpret_cast<BufferObject *>(self);
+      b->owner.~shared_ptr();
+      b->shape.~vector();
+      b->strides.~vector();
+      PyTypeObject *type = Py_TYPE(self);
+      type->tp_free(self);
+      Py_DECREF(type);
+    }
+
+    /** per-interpreter buffer exporter type */
+    struct BufferType
+    {
+      Var type;
+
+      BufferType()
+      {
+        static PyType_Slot slots[] = {
+            {Py_tp_dealloc, reinterpret_cast<void *>(&bufferDealloc)},
+#if PY_VERSION_HEX >= 0x03090000
+            {Py_bf_getbuffer, reinterpret_cast<void *>(&bufferGet)},
+#endif
+            {Py_tp_doc, const_cast<char *>("memory block owned by C++ code")},
+            {0, NULL}};
+        static PyType_Spec spec = {"cppy3.buffer", sizeof(BufferObject), 0, Py_TPFLAGS_DEFAULT, slots};
+#ifdef Py_TPFLAGS_DISALLOW_INSTANTIATION
+        spec.flags |= Py_TPFLAGS_DISALLOW_INSTANTIATION;
+#endif
+        type.newRef(PyType_FromSpec(&spec));
+        assert(type.data());
+#if PY_VERSION_HEX < 0x03090000
+        // buffer slots of type spec are supported since python 3.9
+        PyHeapTypeObject *heapType = reinterpret_cast<PyHeapTypeObject *>(type.data());
+        heapType->as_buffer.bf_getbuffer = &bufferGet;
+        heapType->ht_type.tp_as_buffer = &heapType->as_buffer;
+#endif
+      }
+    };
+  }
+
+  LIB_API PyObject *convertBuffer(void *data, size_t count, size_t itemsize, const char *format,
+                                  const std::shared_ptr<void> &owner, bool readonly)
+  {
+    return convertBuffer(data, std::vector<Py_ssize_t>{static_cast<Py_ssize_t>(count)}, itemsize, format, owner, readonly);
+  }
+
+  LIB_API PyObject *convertBuffer(void *data, const std::vector<Py_ssize_t> &shape, size_t itemsize, const char *format,
+                                  const std::shared_ptr<void> &owner, bool readonly, const std::vector<Py_ssize_t> &strides)
+  {
+    assert(format);
+    if (shape.size() > PyBUF_MAX_NDIM || (!strides.empty() && strides.size() != shape.size()))
+    {
+      PyErr_Format(PyExc_ValueError, "buffer of %zu dimensions with %zu strides", shape.size(), strides.size());
+      return NULL;
+    }
+    PyTypeObject *type = reinterpret_cast<PyTypeObject *>(interpreterLocal<BufferType>("cppy3.BufferType")->type.data());
+    Var exporter = Var::from(type->tp_alloc(type, 0));
+    if (exporter.null())
+    {
+      return NULL;
+    }
+    BufferObject *b = reinterpret_cast<BufferObject *>(exporter.data());
+    new (&b->owner) std::shared_ptr<void>(owner);
+    new (&b->shape) std::vector<Py_ssize_t>(shape);
+    new (&b->strides) std::vector<Py_ssize_t>(strides);
+    b->itemsize = itemsize;
+    b->len = itemsize;
+    for (Py_ssize_t n : shape)
+    {
+      b->len *= n;
+    }
+    if (strides.empty())
+    {
+      b->strides.resize(shape.size());
+      Py_ssize_t stride = itemsize;
+      for (size_t d = shape.size(); d-- > 0;)
+      {
+        b->strides[d] = stride;
+        stride *= shape[d];
+      }
+    }
+    // empty views still need valid address
+    b->data = data ? data : &b->itemsize;
+    b->format = format;
+    b->readonly = readonly;
+    b->cContiguous = denseStrides(b->shape, b->strides, b->itemsize, true);
+    b->fContiguous = denseStrides(b->shape, b->strides, b->itemsize, false);
+    return PyMemoryView_FromObject(exporter);
+  }
+
   LIB_API PyObject *convert(const char *value)
   {
     PyObject *o = PyUnicode_FromString(value);
     return o;
   }
 
+  LIB_API PyObject *convert(std::string_view value)
+  {
+    PyObject *o = PyUnicode_FromStringAndSize(value.data(), value.size());
+    return o;
+  }
+
   LIB_API PyObject *convert(const std::wstring &value)
   {
     PyObject *o = PyUnicode_FromWideChar(value.data(), value.size());
@@ -342,6 +962,30 @@ namespace cppy3
 
   }
 
+  LIB_API void extract(PyObject *o, std::string &value)
+  {
+    Var str(o);
+    if (!PyUnicode_Check(o))
+    {
+      // try cast to string
+      str.newRef(PyObject_Str(o));
+      if (!str.data())
+      {
+        PyErr_Clear();
+        throw PythonException(L"variable has no string representation");
+      }
+    }
+
+    // utf-8 representation is cached inside unicode object
+    Py_ssize_t size = 0;
+    const char *utf8String = PyUnicode_AsUTF8AndSize(str, &size);
+    if (utf8String == NULL)
+    {
+      rethrowPythonException();
+    }
+    value.assign(utf8String, size);
+  }
+
   LIB_API void extract(PyObject *o, double &value)
   {
     if (PyFloat_Check(o))
@@ -359,6 +1003,28 @@ namespace cppy3
     if (PyLong_Check(o))
     {
       value = PyLong_AsLong(o);
+      if (value == -1 && PyErr_Occurred())
+      {
+        // OverflowError
+        rethrowPythonException();
+      }
+    }
+    else
+    {
+      throw PythonException(L"variable is not a long type");
+    }
+  }
+
+  LIB_API void extract(PyObject *o, long long &value)
+  {
+    if (PyLong_Check(o))
+    {
+      value = PyLong_AsLongLong(o);
+      if (value == -1 && PyErr_Occurred())
+      {
+        // OverflowError
+        rethrowPythonException();
+      }
     }
     else
     {
@@ -366,6 +1032,86 @@ namespace cppy3
     }
   }
 
+  LIB_API void extract(PyObject *o, int &value)
+  {
+    long longValue = 0;
+    extract(o, longValue);
+    if (longValue < INT_MIN || longValue > INT_MAX)
+    {
+      throw PythonException(L"variable does not fit int type");
+    }
+    value = static_cast<int>(longValue);
+  }
+
+  LIB_API void extract(PyObject *o, float &value)
+  {
+    double doubleValue = 0;
+    extract(o, doubleValue);
+    value = static_cast<float>(doubleValue);
+  }
+
+  /** @return kind of struct module element format: f - float, i - signed, u - unsigned, ? - bool, 0 - other */
+  static char bufferFormatKind(const char *format)
+  {
+    // native and little/big endian prefixes are accepted when they describe native order
+    switch (*format)
+    {
+    case '@':
+    case '=':
+      ++format;
+      break;
+    case '<':
+    case '>':
+    case '!':
+    {
+      const unsigned short probe = 1;
+      const bool littleEndian = *reinterpret_cast<const unsigned char *>(&probe) == 1;
+      if ((*format == '<') != littleEndian)
+      {
+        return 0;
+      }
+      ++format;
+      break;
+    }
+    }
+    if (format[0] == '\0' || format[1] != '\0')
+    {
+      return 0;
+    }
+    switch (format[0])
+    {
+    case 'e':
+    case 'f':
+    case 'd':
+    case 'g':
+      return 'f';
+    case 'b':
+    case 'h':
+    case 'i':
+    case 'l':
+    case 'q':
+    case 'n':
+      return 'i';
+    case 'B':
+    case 'H':
+    case 'I':
+    case 'L':
+    case 'Q':
+    case 'N':
+      return 'u';
+    case '?':
+      return '?';
+    default:
+      return 0;
+    }
+  }
+
+  LIB_API bool bufferFormatMatches(const char *format, const char *expected)
+  {
+    const char kind = bufferFormatKind(format);
+    return kind != 0 && kind == bufferFormatKind(expected);
+  }
+
   LIB_API std::wstring Var::toString() const
   {
     return toString(_o);
@@ -376,18 +1122,20 @@ namespace cppy3
     assert(val);
     std::wstringstream result;
     // try str() operator
-    PyObject *str = PyObject_Str(val);
-    if (!str)
+    Var str = Var::from(PyObject_Str(val));
+    if (str.null())
     {
       // try repr() operator
-      str = PyObject_Repr(val);
+      PyErr_Clear();
+      str.newRef(PyObject_Repr(val));
     }
-    if (str)
+    if (!str.null())
     {
       result << pyUnicodeToWstring(str);
     }
     else
     {
+      PyErr_Clear();
       result << "< type='" << val->ob_type->tp_name << L"' has no string representation >";
     }
     return result.str();
@@ -465,51 +1213,74 @@ namespace cppy3
     return module;
   }
 
+  /** @return new reference to parent[key] or parent.key, NULL without error set if not found */
+  static PyObject *lookupMember(PyObject *parent, PyObject *key)
+  {
+    if (PyDict_Check(parent))
+    {
+      return dictItem(parent, key);
+    }
+    PyObject *o = PyObject_GetAttr(parent, key);
+    if (!o)
+    {
+      PyErr_Clear();
+    }
+    return o;
+  }
+
+  /** split dotted path "a.b.c" into items */
+  static std::vector<std::string_view> splitDotted(std::string_view name)
+  {
+    std::vector<std::string_view> items;
+    while (!name.empty())
+    {
+      const size_t dot = name.find('.');
+      items.push_back(name.substr(0, dot));
+      name.remove_prefix(dot == std::string_view::npos ? name.size() : dot + 1);
+    }
+    return items;
+  }
+
   LIB_API Var lookupObject(PyObject *module, const std::wstring &name)
   {
-    std::wstring temp;
-    std::vector<std::wstring> items;
-    std::wstringstream wss(name);
-    while (std::getline(wss, temp, L'.'))
-      items.push_back(temp);
+    return lookupObject(module, WideToUTF8(name));
+  }
 
+  LIB_API Var lookupObject(PyObject *module, std::string_view name)
+  {
     Var p(module);
-    // Var prev;  // (1) cause refcount bug
-    std::string itemName;
-    for (auto it = items.begin(); it != items.end() && !p.null(); ++it)
+    for (std::string_view item : splitDotted(name))
     {
-
-      // prev = p; // (2) cause refcount bug
-      itemName = WideToUTF8(*it);
-      if (PyDict_Check(p))
+      const Var key = Var::from(convert(item));
+      if (key.null())
       {
-        p = Var(PyDict_GetItemString(p, itemName.data()));
-      }
-      else
-      {
-        // PyObject_GetAttrString returns new reference
-        p.newRef(PyObject_GetAttrString(p, itemName.data()));
+        rethrowPythonException();
       }
-
+      p.newRef(lookupMember(p, key));
       if (p.null())
       {
-        std::wstringstream wss;
-        wss << L"lookup " << name << L" failed: no item " << UTF8ToWide(itemName);
-        throw PythonException(wss.str());
+        std::stringstream ss;
+        ss << "lookup " << name << " failed: no item " << item;
+        throw PythonException(ss.str());
       }
     }
     return p;
   }
 
   LIB_API Var lookupCallable(PyObject *module, const std::wstring &name)
+  {
+    return lookupCallable(module, WideToUTF8(name));
+  }
+
+  LIB_API Var lookupCallable(PyObject *module, std::string_view name)
   {
     Var p = lookupObject(module, name);
 
     if (!PyCallable_Check(p))
     {
-      std::wstringstream wss;
-      wss << L"PyObject " << name << L" is not callable";
-      throw PythonException(wss.str());
+      std::stringstream ss;
+      ss << "PyObject " << name << " is not callable";
+      throw PythonException(ss.str());
     }
 
     return p;
@@ -533,8 +1304,8 @@ namespace cppy3
       argsTuple.newRef(PyTuple_New(argsCount));
       for (int i = 0; i < argsCount; i++)
       {
-        // steals reference
-        PyTuple_SetItem(argsTuple, i, args[i]);
+        // steals reference, args keep their own
+        PyTuple_SetItem(argsTuple, i, convert(args[i].data()));
       }
     }
 
@@ -545,12 +1316,149 @@ namespace cppy3
     return result;
   }
 
+  LIB_API Var callArgv(PyObject *callable, PyObject **argv, size_t nargs)
+  {
+    assert(callable);
+    for (size_t i = 0; i < nargs; ++i)
+    {
+      if (!argv[i])
+      {
+        rethrowPythonException();
+        throw PythonException(L"argument conversion failed");
+      }
+    }
+
+    Var result;
+#if PY_VERSION_HEX >= 0x03090000
+    result.newRef(PyObject_Vectorcall(callable, argv, nargs | PY_VECTORCALL_ARGUMENTS_OFFSET, NULL));
+#else
+    Var argsTuple = Var::from(PyTuple_New(nargs));
+    for (size_t i = 0; i < nargs; ++i)
+    {
+      Py_INCREF(argv[i]);
+      PyTuple_SET_ITEM(argsTuple.data(), i, argv[i]);
+    }
+    result.newRef(PyObject_CallObject(callable, argsTuple));
+#endif
+    if (result.null())
+    {
+      rethrowPythonException();
+    }
+    return result;
+  }
+
+  LIB_API Function::Function(const std::wstring &name, bool autoRefresh)
+      : Function(getMainModule(), name, autoRefresh)
+  {
+  }
+
+  LIB_API Function::Function(std::string_view name, bool autoRefresh)
+      : Function(getMainModule(), name, autoRefresh)
+  {
+  }
+
+  LIB_API Function::Function(PyObject *scope, const std::wstring &name, bool autoRefresh)
+      : Function(scope, WideToUTF8(name), autoRefresh)
+  {
+  }
+
+  LIB_API Function::Function(PyObject *scope, std::string_view name, bool autoRefresh)
+      : _name(name), _autoRefresh(autoRefresh)
+  {
+    assert(scope);
+    GILLocker lock;
+    // module attributes live in its dict, look them up directly
+    _scope.reset(PyModule_Check(scope) ? PyModule_GetDict(scope) : scope);
+
+    for (std::string_view item : splitDotted(name))
+    {
+      PyObject *key = convert(item);
+      PyUnicode_InternInPlace(&key);
+      _keys.push_back(Var::from(key));
+    }
+    refresh();
+  }
+
+  LIB_API void Function::refresh()
+  {
+    GILLocker lock;
+    _path.clear();
+    _callable.reset(NULL);
+
+    PyObject *parent = _scope;
+    for (const Var &key : _keys)
+    {
+      Var member = Var::from(lookupMember(parent, key));
+      if (member.null())
+      {
+        std::stringstream ss;
+        ss << "lookup " << _name << " failed: no item " << PyUnicode_AsUTF8(key);
+        throw PythonException(ss.str());
+      }
+      _path.push_back(member);
+      parent = member;
+    }
+
+    if (_path.empty() || !PyCallable_Check(_path.back()))
+    {
+      std::stringstream ss;
+      ss << "PyObject " << _name << " is not callable";
+      throw PythonException(ss.str());
+    }
+    _callable.reset(_path.back());
+  }
+
+  namespace
+  {
+    /** @return true if @b fresh lookup gives @b cached object or bound method of same function and self */
+    bool sameMember(PyObject *fresh, PyObject *cached)
+    {
+      if (fresh == cached)
+      {
+        return true;
+      }
+      // attribute access creates new bound method object each time
+      if (fresh && PyMethod_Check(fresh) && PyMethod_Check(cached))
+      {
+        return PyMethod_GET_FUNCTION(fresh) == PyMethod_GET_FUNCTION(cached) && PyMethod_GET_SELF(fresh) == PyMethod_GET_SELF(cached);
+      }
+      if (fresh && PyCFunction_Check(fresh) && PyCFunction_Check(cached))
+      {
+        return reinterpret_cast<PyCFunctionObject *>(fresh)->m_ml == reinterpret_cast<PyCFunctionObject *>(cached)->m_ml &&
+               PyCFunction_GET_SELF(fresh) == PyCFunction_GET_SELF(cached);
+      }
+      return false;
+    }
+  }
+
+  LIB_API bool Function::rebound() const
+  {
+    PyObject *parent = _scope;
+    for (size_t i = 0; i < _keys.size(); ++i)
+    {
+      // fresh bound method is compared by content, keep it alive until then
+      const Var member = Var::from(lookupMember(parent, _keys[i]));
+      if (!sameMember(member.data(), _path[i].data()))
+      {
+        return true;
+      }
+      // fresh bound method may be gone already, cached one is equivalent
+      parent = _path[i].data();
+    }
+    return false;
+  }
+
   LIB_API PyObject *call(const char *callable, const arguments &args)
   {
-    return call(lookupCallable(getMainModule(), UTF8ToWide(callable)), args);
+    return call(lookupCallable(getMainModule(), std::string_view(callable)), args);
   }
 
-  LIB_API GILLocker::GILLocker() : _locked(false)
+#if CPPY3_GIL_STATS
+  LIB_API GILLocker::GILLocker(const char *file, int line)
+      : _locked(false), _threadState(NULL), _file(file), _line(line), _waitNs(0), _acquiredAt(0)
+#else
+  LIB_API GILLocker::GILLocker() : _locked(false), _threadState(NULL)
+#endif
   {
     // autolock GIL in scoped_lock style
     lock();
@@ -566,7 +1474,17 @@ namespace cppy3
     if (_locked)
     {
       assert(Py_IsInitialized());
-      PyGILState_Release(_pyGILState);
+#if CPPY3_GIL_STATS
+      recordGILAcquisition(GILLockKind::LOCKER, _file, _line, _waitNs, gilClock() - _acquiredAt);
+#endif
+      if (_threadState)
+      {
+        PyEval_SaveThread();
+      }
+      else
+      {
+        PyGILState_Release(_pyGILState);
+      }
       _locked = false;
     }
   }
@@ -576,13 +1494,90 @@ namespace cppy3
     if (!_locked)
     {
       assert(Py_IsInitialized());
-      _pyGILState = PyGILState_Ensure();
+      // PyGILState API knows main interpreter only,
+      // thread running sub-interpreter is attached and needs no locking
+      if (attachedThreadState())
+      {
+        return;
+      }
+#if CPPY3_GIL_STATS
+      const uint64_t start = gilClock();
+#endif
+      _threadState = ThreadAttachment::current();
+      if (_threadState)
+      {
+        PyEval_RestoreThread(_threadState);
+      }
+      else
+      {
+        _pyGILState = PyGILState_Ensure();
+      }
       _locked = true;
+#if CPPY3_GIL_STATS
+      _acquiredAt = gilClock();
+      _waitNs = _acquiredAt - start;
+#endif
     }
   }
 
   LIB_API bool GILLocker::isLocked() {
-    return PyGILState_Check() == 1;
+    return attachedThreadState() != NULL;
+  }
+
+  LIB_API ThreadAttachment::ThreadAttachment() : _owner(false)
+  {
+    assert(Py_IsInitialized());
+    if (current())
+    {
+      return;
+    }
+    const bool attached = attachedThreadState() != NULL;
+    // counted reference to the gilstate thread state keeps it from being deleted
+    _gilState = PyGILState_Ensure();
+    attachedThread = {PyGILState_GetThisThreadState(), vmGeneration.load()};
+    _owner = true;
+    if (!attached)
+    {
+      PyEval_SaveThread();
+    }
+  }
+
+  LIB_API ThreadAttachment::~ThreadAttachment()
+  {
+    if (!_owner)
+    {
+      return;
+    }
+    PyThreadState *state = current();
+    attachedThread = {NULL, 0};
+    if (!state)
+    {
+      // interpreter has been finalized together with the state
+      return;
+    }
+    if (attachedThreadState() != state)
+    {
+      PyEval_RestoreThread(state);
+    }
+    PyGILState_Release(_gilState);
+  }
+
+  LIB_API PyThreadState *ThreadAttachment::current()
+  {
+    return attachedThread.state && attachedThread.generation == vmGeneration.load() ? attachedThread.state : NULL;
+  }
+
+  LIB_API PyThreadState *attachedThreadState()
+  {
+#if PY_VERSION_HEX >= 0x030D0000
+    return PyThreadState_GetUnchecked();
+#elif PY_VERSION_HEX >= 0x030C0000
+    return _PyThreadState_UncheckedGet();
+#else
+    // before 3.12 current thread state is process wide: it belongs to whichever thread holds GIL
+    PyThreadState *current = _PyThreadState_UncheckedGet();
+    return current && current == PyGILState_GetThisThreadState() ? current : NULL;
+#endif
   }
 
 
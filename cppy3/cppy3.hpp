@@ -18,14 +18,54 @@
 
 #include <Python.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <list>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "libdefs.hpp"
 #include "utils.hpp"
 
+/**
+ * Free-threaded python build (PEP 703, e.g. python3.13t) runs without GIL,
+ * objects shared between threads are protected by per-object locks instead
+ */
+#ifdef Py_GIL_DISABLED
+#define CPPY3_FREE_THREADED 1
+#else
+#define CPPY3_FREE_THREADED 0
+#endif
+
+/**
+ * GIL wait and hold time instrumentation of GILLocker, ScopedGILLock and ScopedGILRelease,
+ * off unless built with CPPY3_GIL_STATS=1 (cmake option of the same name), @see cppy3_gilstats.hpp
+ */
+#ifndef CPPY3_GIL_STATS
+#define CPPY3_GIL_STATS 0
+#endif
+
+#if CPPY3_GIL_STATS
+// call site of the lock is captured by default arguments
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1926)
+#define CPPY3_CALLER_FILE __builtin_FILE()
+#define CPPY3_CALLER_LINE __builtin_LINE()
+#else
+#define CPPY3_CALLER_FILE "<unknown>"
+#define CPPY3_CALLER_LINE 0
+#endif
+#endif
+
 namespace cppy3
 {
 
@@ -41,8 +81,28 @@ namespace cppy3
   LIB_API Var exec(const char *pythonScript);
   LIB_API Var exec(const std::wstring &pythonScript);
   LIB_API Var exec(const std::string &pythonScript);
+  /** evaluate expression and return its value, statements are executed and give None */
   LIB_API Var eval(const char *pythonScript);
 
+  /**
+   * exec() and eval() keep compiled code objects in a bounded LRU cache
+   * keyed by source text and compile mode, so repeated snippets skip compilation.
+   * Cache is kept per interpreter and dropped on its shutdown.
+   */
+  struct CodeCacheStats
+  {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t size;
+    size_t capacity;
+  };
+
+  LIB_API CodeCacheStats codeCacheStats();
+  /** @param capacity - max number of cached code objects, 0 disables caching */
+  LIB_API void setCodeCacheCapacity(size_t capacity);
+  LIB_API void clearCodeCache();
+
   /** exec python script file */
   LIB_API Var execScriptFile(const std::string &path);
 
@@ -51,9 +111,11 @@ namespace cppy3
 
   /** Add to sys.path */
   void appendToSysPath(const std::vector<std::wstring> &paths);
+  void appendToSysPath(const std::vector<std::string> &paths);
 
   /** Make instance of a class */
   Var createClassInstance(const std::wstring &callable);
+  Var createClassInstance(std::string_view callable);
 
   /** Send ctrl-c */
   void interrupt();
@@ -88,9 +150,21 @@ namespace cppy3
   LIB_API PyObject *call(PyObject *callable, const arguments &args = arguments());
   LIB_API PyObject *call(const char *callable, const arguments &args = arguments());
 
-  /** get reference to an object in python's namespace */
+  /**
+   * call python callable via vectorcall protocol without args tuple allocation
+   * @param argv - array of nargs borrowed references, argv[-1] must be writable scratch slot
+   * @see vectorcall() for typed variadic version
+   */
+  LIB_API Var callArgv(PyObject *callable, PyObject **argv, size_t nargs);
+
+  /**
+   * get reference to an object in python's namespace
+   * @param name - dotted path, e.g. "os.path.join", utf-8 in narrow version
+   */
   LIB_API Var lookupObject(PyObject *module, const std::wstring &name);
+  LIB_API Var lookupObject(PyObject *module, std::string_view name);
   LIB_API Var lookupCallable(PyObject *module, const std::wstring &name);
+  LIB_API Var lookupCallable(PyObject *module, std::string_view name);
 
   /**
    * Tiny wrapper over CPython interpreter instance
@@ -106,14 +180,44 @@ namespace cppy3
     ~PythonVM();
   };
 
+  /**
+   * Traceback text lines, formatted with traceback.format_tb() on first access.
+   * Until then only the traceback object is referenced, so exceptions that are
+   * caught and dropped never pay for formatting. Copies share formatted lines.
+   */
+  class LIB_API TraceLines
+  {
+  public:
+    typedef std::vector<std::wstring>::const_iterator const_iterator;
+
+    TraceLines() {}
+    TraceLines(const std::vector<std::wstring> &lines);
+    /** keep new reference to python traceback object */
+    explicit TraceLines(PyObject *traceback);
+
+    /** formatted lines, takes GIL on first call */
+    const std::vector<std::wstring> &lines() const;
+    operator const std::vector<std::wstring> &() const { return lines(); }
+
+    size_t size() const { return lines().size(); }
+    bool empty() const { return lines().empty(); }
+    const std::wstring &operator[](size_t i) const { return lines()[i]; }
+    const_iterator begin() const { return lines().begin(); }
+    const_iterator end() const { return lines().end(); }
+
+  private:
+    struct State;
+    std::shared_ptr<State> _state;
+  };
+
   struct PyExceptionData
   {
     std::wstring type;
     std::wstring reason;
-    std::vector<std::wstring> trace;
+    TraceLines trace;
 
     explicit PyExceptionData(const std::wstring &reason = std::wstring()) throw() : reason(reason) {}
-    explicit PyExceptionData(const std::wstring &type, const std::wstring &reason, const std::vector<std::wstring> &trace) throw() : type(type), reason(reason), trace(trace) {}
+    explicit PyExceptionData(const std::wstring &type, const std::wstring &reason, const TraceLines &trace) throw() : type(type), reason(reason), trace(trace) {}
 
     bool isEmpty() const throw()
     {
@@ -123,7 +227,7 @@ namespace cppy3
     std::wstring toString() const
     {
       std::wstring traceText;
-      for (auto t : trace)
+      for (const std::wstring &t : trace)
       {
         traceText += t + L'\n';
       }
@@ -134,28 +238,124 @@ namespace cppy3
   class PythonException : public std::exception
   {
   public:
-    PythonException(const PyExceptionData &info_) : info(info_), _what(WideToUTF8(info.toString())) {}
-    PythonException(const std::wstring &reason) : info(reason), _what(WideToUTF8(info.toString())) {}
+    PythonException(const PyExceptionData &info_) : info(info_), _what(std::make_shared<What>()) {}
+    PythonException(const std::wstring &reason) : info(reason), _what(std::make_shared<What>()) {}
+    /** @param reason - utf-8 message */
+    PythonException(const std::string &reason) : info(UTF8ToWide(reason)), _what(std::make_shared<What>()) {}
     ~PythonException() throw() {}
 
+    /** message with traceback, built on first call */
     const char *what() const throw()
     {
-      return _what.c_str();
+      std::call_once(_what->once, [this]() { _what->text = WideToUTF8(info.toString()); });
+      return _what->text.c_str();
     }
     const PyExceptionData info;
 
   private:
-    const std::string _what;
+    struct What
+    {
+      std::once_flag once;
+      std::string text;
+    };
+    std::shared_ptr<What> _what;
   };
 
+  /**
+   * Scoped per-object lock for compound operations on shared list or dict,
+   * e.g. check-then-insert or iteration. No-op when GIL serializes access.
+   * Unlike Py_BEGIN_CRITICAL_SECTION it is released on exception.
+   */
+  class CriticalSection
+  {
+  public:
+    explicit CriticalSection(PyObject *o)
+    {
+#if CPPY3_FREE_THREADED
+      PyCriticalSection_Begin(&_section, o);
+#else
+      (void)o;
+#endif
+    }
+
+    ~CriticalSection()
+    {
+#if CPPY3_FREE_THREADED
+      PyCriticalSection_End(&_section);
+#endif
+    }
+
+    CriticalSection(const CriticalSection &) = delete;
+    CriticalSection &operator=(const CriticalSection &) = delete;
+
+  private:
+#if CPPY3_FREE_THREADED
+    PyCriticalSection _section;
+#endif
+  };
+
+  /**
+   * @return new reference to dict[key] or NULL if there is no such key, errors are suppressed.
+   * Unlike borrowed PyDict_GetItem() result it stays valid while other threads modify dict
+   */
+  inline PyObject *dictItem(PyObject *dict, PyObject *key)
+  {
+    PyObject *item = NULL;
+#if PY_VERSION_HEX >= 0x030D0000
+    if (PyDict_GetItemRef(dict, key, &item) < 0)
+    {
+      PyErr_Clear();
+    }
+#else
+    item = PyDict_GetItemWithError(dict, key);
+    Py_XINCREF(item);
+    if (!item)
+    {
+      PyErr_Clear();
+    }
+#endif
+    return item;
+  }
+
+  inline PyObject *dictItem(PyObject *dict, const char *key)
+  {
+    PyObject *item = NULL;
+#if PY_VERSION_HEX >= 0x030D0000
+    if (PyDict_GetItemStringRef(dict, key, &item) < 0)
+    {
+      PyErr_Clear();
+    }
+#else
+    item = PyDict_GetItemString(dict, key);
+    Py_XINCREF(item);
+#endif
+    return item;
+  }
+
+  /**
+   * @return interpreter of calling thread, GIL required
+   */
+  inline PyInterpreterState *currentInterpreter()
+  {
+#if PY_VERSION_HEX >= 0x03090000
+    return PyInterpreterState_Get();
+#else
+    return PyThreadState_Get()->interp;
+#endif
+  }
+
   /**
    * Setters / getters for access and manipulation with python vars and namespaces
    */
   LIB_API PyObject *convert(const char *value);
-  LIB_API PyObject *convert(const std::wstring &value);
+  /** @param value - utf-8 text */
+  LIB_API PyObject *convert(std::string_view value);
   LIB_API PyObject *convert(const std::wstring &value);
   LIB_API PyObject *convert(const int &value);
+  LIB_API PyObject *convert(const long &value);
   LIB_API PyObject *convert(const double &value);
+  /** pass python object as is, @return new reference */
+  LIB_API PyObject *convert(PyObject *value);
 
   template <typename T>
   PyObject *convert(const std::vector<T> &value)
@@ -173,6 +373,70 @@ namespace cppy3
     return o;
   }
 
+  /**
+   * @return python struct module format character of numeric type T
+   */
+  template <typename T>
+  constexpr const char *bufferFormat()
+  {
+    static_assert(std::is_arithmetic<T>::value, "numeric type expected");
+    if constexpr (std::is_same<T, bool>::value)
+      return "?";
+    else if constexpr (std::is_floating_point<T>::value)
+    {
+      static_assert(sizeof(T) == 4 || sizeof(T) == 8, "struct module has no format of extended precision floating type");
+      return sizeof(T) == 4 ? "f" : "d";
+    }
+    else if constexpr (std::is_signed<T>::value)
+      return sizeof(T) == 1 ? "b" : sizeof(T) == 2 ? "h" : sizeof(T) == 4 ? "i" : "q";
+    else
+      return sizeof(T) == 1 ? "B" : sizeof(T) == 2 ? "H" : sizeof(T) == 4 ? "I" : "Q";
+  }
+
+  /**
+   * Expose contiguous memory block to python as memoryview without per-element boxing
+   * @param data - first element
+   * @param count - number of elements
+   * @param itemsize - size of element in bytes
+   * @param format - struct module format of element, must have static storage
+   * @param owner - memory owner, released when python drops the last view
+   * @return new reference to memoryview
+   */
+  LIB_API PyObject *convertBuffer(void *data, size_t count, size_t itemsize, const char *format,
+                                  const std::shared_ptr<void> &owner, bool readonly = false);
+
+  /**
+   * Expose N-d memory block to python as memoryview without copying, see 1d convertBuffer() for other parameters
+   * @param shape - size of each dimension
+   * @param strides - distance between elements of each dimension in bytes, C-contiguous if empty
+   * @return new reference to memoryview or NULL with python error set
+   */
+  LIB_API PyObject *convertBuffer(void *data, const std::vector<Py_ssize_t> &shape, size_t itemsize, const char *format,
+                                  const std::shared_ptr<void> &owner, bool readonly = false,
+                                  const std::vector<Py_ssize_t> &strides = std::vector<Py_ssize_t>());
+
+  /**
+   * Zero-copy conversion of numeric vector to memoryview
+   * Python shares vector data and keeps vector alive while any view of it exists,
+   * vector must not be resized meanwhile
+   */
+  template <typename T>
+  PyObject *convertBuffer(const std::shared_ptr<std::vector<T>> &value)
+  {
+    static_assert(!std::is_same<T, bool>::value, "std::vector<bool> is not contiguous");
+    return convertBuffer(value->data(), value->size(), sizeof(T), bufferFormat<T>(), value);
+  }
+
+  /**
+   * Copy-once conversion of numeric vector to memoryview
+   * Contents are copied in bulk into a block owned by python
+   */
+  template <typename T>
+  PyObject *convertBuffer(const std::vector<T> &value)
+  {
+    return convertBuffer(std::make_shared<std::vector<T>>(value));
+  }
+
 #if HAVE_MATRIX_CONTAINER
   template <typename T>
   PyObject *varCreator(const Matrix<T> &value)
@@ -198,29 +462,73 @@ namespace cppy3
 #endif
 
   LIB_API void extract(PyObject *o, std::wstring &value);
+  /** extract utf-8 text */
+  LIB_API void extract(PyObject *o, std::string &value);
   LIB_API void extract(PyObject *o, long &value);
   LIB_API void extract(PyObject *o, double &value);
 
+  LIB_API void extract(PyObject *o, int &value);
+  LIB_API void extract(PyObject *o, long long &value);
+  LIB_API void extract(PyObject *o, float &value);
+
+  /**
+   * Extract list, tuple, any sequence but str or buffer (e.g. numpy.ndarray, memoryview)
+   * Contiguous buffers of matching element type are copied in bulk
+   */
   template <typename T>
-  void extract(PyObject *o, std::vector<T> &value)
-  {
-    assert(o);
-    value.reset(0);
+  void extract(PyObject *o, std::vector<T> &value);
+
+  /** @return true if struct module @b format describes element of same kind as @b expected format */
+  LIB_API bool bufferFormatMatches(const char *format, const char *expected);
 
-    if (PyList_Check(o))
+  /**
+   * Bulk copy buffer of T elements into vector, memcpy for contiguous and strided loop for 1d buffers
+   * @return false if object does not export buffer of matching element type
+   */
+  template <typename T>
+  bool extractBuffer(PyObject *o, std::vector<T> &value)
+  {
+    if constexpr (!std::is_arithmetic<T>::value || std::is_same<T, bool>::value)
     {
-      value.reset(PyList_Size(o));
-      for (int i = 0; i < PyList_Size(o); i++)
-      {
-        PyObject *item = PyList_GetItem(o, i);
-        T itemValue;
-        extract(item, itemValue);
-        value[i] = itemValue;
-      }
+      return false;
     }
     else
     {
-      throw PythonException(L"variable is not a list");
+      if (!PyObject_CheckBuffer(o))
+      {
+        return false;
+      }
+      Py_buffer view;
+      if (PyObject_GetBuffer(o, &view, PyBUF_RECORDS_RO) != 0)
+      {
+        PyErr_Clear();
+        return false;
+      }
+      bool matches = view.itemsize == sizeof(T) && bufferFormatMatches(view.format ? view.format : "B", bufferFormat<T>());
+      if (matches && PyBuffer_IsContiguous(&view, 'C'))
+      {
+        value.resize(view.len / sizeof(T));
+        if (view.len > 0)
+        {
+          std::memcpy(value.data(), view.buf, view.len);
+        }
+      }
+      else if (matches && view.ndim == 1 && !view.suboffsets)
+      {
+        const char *src = static_cast<const char *>(view.buf);
+        value.resize(view.shape[0]);
+        for (Py_ssize_t i = 0; i < view.shape[0]; ++i, src += view.strides[0])
+        {
+          std::memcpy(&value[i], src, sizeof(T));
+        }
+      }
+      else
+      {
+        // multidimensional strided layout, go elementwise
+        matches = false;
+      }
+      PyBuffer_Release(&view);
+      return matches;
     }
   }
 
@@ -312,13 +620,38 @@ namespace cppy3
       reset(other.data());
     }
 
+    /** Take over reference of @b other, no refcount change */
+    Var(Var &&other) noexcept : _o(other._o)
+    {
+      other._o = NULL;
+    }
+
+    Var &operator=(const Var &other)
+    {
+      reset(other.data());
+      return *this;
+    }
+
+    Var &operator=(Var &&other) noexcept
+    {
+      // old object is released last, its destructor may run python code
+      Var old(std::move(other));
+      swap(old);
+      return *this;
+    }
+
+    void swap(Var &other) noexcept
+    {
+      std::swap(_o, other._o);
+    }
+
     /**
      * Construct holder for object parent[name]
      */
     explicit Var(const char *name, const PyObject *parent) : _o(NULL)
     {
       assert(name && parent);
-      reset(PyDict_GetItemString(const_cast<PyObject *>(parent), name));
+      newRef(dictItem(const_cast<PyObject *>(parent), name));
       assert(_o);
     }
 
@@ -328,7 +661,17 @@ namespace cppy3
     explicit Var(const std::wstring &name, const PyObject *parent) : _o(NULL)
     {
       assert(parent);
-      reset(PyDict_GetItem(const_cast<PyObject *>(parent), Var::from(convert(name))));
+      newRef(dictItem(const_cast<PyObject *>(parent), Var::from(convert(name))));
+      assert(_o);
+    }
+
+    /**
+     * Construct holder for object parent[name], @b name is utf-8
+     */
+    explicit Var(std::string_view name, const PyObject *parent) : _o(NULL)
+    {
+      assert(parent);
+      newRef(dictItem(const_cast<PyObject *>(parent), Var::from(convert(name))));
       assert(_o);
     }
 
@@ -352,6 +695,12 @@ namespace cppy3
       return Var(name, _o);
     }
 
+    Var var(std::string_view name) const
+    {
+      assert(_o && "to get child object this must have parent");
+      return Var(name, _o);
+    }
+
     /**
      * Hold PyObject
      * reference increased
@@ -391,6 +740,17 @@ namespace cppy3
       return v;
     }
 
+    /**
+     * Give up ownership without decrement of reference
+     * @return owned reference to held object, caller becomes responsible for it
+     */
+    PyObject *release() noexcept
+    {
+      PyObject *o = _o;
+      _o = NULL;
+      return o;
+    }
+
     /**
      * Get pointer to contained PyObject
      */
@@ -501,16 +861,14 @@ namespace cppy3
     template <typename T>
     void getVar(const std::string &varName, T &value) const
     {
-      PyObject *o = PyDict_GetItemString(*this, varName.data());
-      assert(o);
+      const Var o(varName.c_str(), _o);
       extract(o, value);
     }
 
     template <typename T>
     void getList(const std::wstring &varName, std::vector<T> &value) const
     {
-      PyObject *o = PyDict_GetItemString(*this, WideToUTF8(varName).data());
-      assert(o);
+      const Var o(varName, _o);
       extract(o, value);
     }
 
@@ -546,6 +904,11 @@ namespace cppy3
     PyObject *_o;
   };
 
+  inline void swap(Var &a, Var &b) noexcept
+  {
+    a.swap(b);
+  }
+
   /**
    * Adapter for python list type
    */
@@ -580,11 +943,22 @@ namespace cppy3
 
     Var operator[](const size_t i)
     {
+#if PY_VERSION_HEX >= 0x030D0000
+      // bounds check and reference taken atomically
+      Var item = Var::from(PyList_GetItemRef(_o, i));
+      if (item.null())
+      {
+        PyErr_Clear();
+        throw PythonException(L"List index of of bounds");
+      }
+      return item;
+#else
       if (i >= size())
       {
         throw PythonException(L"List index of of bounds");
       }
       return Var(PyList_GetItem(_o, i));
+#endif
     }
 
     void remove(const size_t i)
@@ -657,6 +1031,7 @@ namespace cppy3
     }
 
     Dict dict(const std::wstring &name) { return dict(WideToUTF8(name).c_str()); }
+    Dict dict(const std::string &name) { return dict(name.c_str()); }
 
     List list(const char *name) const
     {
@@ -671,6 +1046,7 @@ namespace cppy3
     }
 
     Dict moduledict(const std::wstring &name) { return moduledict(WideToUTF8(name).c_str()); }
+    Dict moduledict(const std::string &name) { return moduledict(name.c_str()); }
 
     /** @} */
 
@@ -697,14 +1073,181 @@ namespace cppy3
     Main() : Dict(getMainDict()) {}
   };
 
+  /**
+   * Python code compiled once and executed many times
+   * without repeated compilation or string conversion
+   */
+  class LIB_API Script
+  {
+  public:
+    /**
+     * Compile script text
+     * @param source - utf-8 python source
+     * @param filename - name of script shown in tracebacks
+     * @param mode - Py_file_input for statements, Py_eval_input for single expression
+     */
+    explicit Script(const std::string &source, const std::string &filename = "<string>", int mode = Py_file_input);
+    explicit Script(const std::wstring &source, const std::string &filename = "<string>", int mode = Py_file_input);
+
+    /** Compile script file */
+    static Script fromFile(const std::string &path);
+
+    /** exec in __main__ namespace */
+    Var exec() const;
+
+    /** exec in given globals / locals namespace, locals defaults to globals, __builtins__ is added to globals if missing */
+    Var exec(PyObject *globals, PyObject *locals = NULL) const;
+
+    /** compiled code object */
+    PyObject *code() const { return _code.data(); }
+
+  private:
+    Var _code;
+  };
+
+  template <typename T>
+  void extract(PyObject *o, std::vector<T> &value)
+  {
+    assert(o);
+    if (extractBuffer(o, value))
+    {
+      return;
+    }
+
+    // str is a sequence of its characters, never meant as list
+    if (PyUnicode_Check(o))
+    {
+      throw PythonException(L"variable is str, not a sequence of items");
+    }
+    const Var sequence = Var::from(PySequence_Fast(o, "variable is not a sequence"));
+    if (sequence.null())
+    {
+      PyErr_Clear();
+      throw PythonException(L"variable is not a sequence");
+    }
+
+    // list items array is shared, keep it from being resized meanwhile
+    CriticalSection lock(sequence);
+    const Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence.data());
+    PyObject **items = PySequence_Fast_ITEMS(sequence.data());
+    value.clear();
+    value.reserve(size);
+    for (Py_ssize_t i = 0; i < size; ++i)
+    {
+      T item;
+      extract(items[i], item);
+      value.push_back(item);
+    }
+  }
+
+  /**
+   * Call python callable with C++ arguments converted via convert()
+   * Arguments are passed on stack via vectorcall protocol, no args tuple is allocated
+   * @return callable result, throws PythonException on error
+   */
+  template <typename... Args>
+  Var vectorcall(PyObject *callable, const Args &...args)
+  {
+    // converted arguments are owned one by one, so throwing conversion releases those done before it
+    const Var held[1 + sizeof...(Args)] = {Var(), Var::from(convert(args))...};
+    // argv[0] is scratch slot for PY_VECTORCALL_ARGUMENTS_OFFSET
+    PyObject *argv[1 + sizeof...(Args)] = {NULL};
+    for (size_t i = 1; i <= sizeof...(Args); ++i)
+    {
+      argv[i] = held[i].data();
+    }
+    return callArgv(callable, argv + 1, sizeof...(Args));
+  }
+
+  /**
+   * Handle to python callable resolved once by dotted name, e.g. "module.Class.method".
+   * Holds strong references, so calls do no name lookups or string conversions.
+   * With autoRefresh the handle re-resolves when any name along the path has been rebound,
+   * checked by identity with pre-built keys (dict version tags are not public API),
+   * bound methods by their function and self. That check costs one lookup per path segment on every call.
+   * GIL must be held while calling.
+   */
+  class LIB_API Function
+  {
+  public:
+    Function() : _autoRefresh(false) {}
+
+    /** resolve callable by dotted @b name in __main__ */
+    explicit Function(const std::wstring &name, bool autoRefresh = false);
+    explicit Function(std::string_view name, bool autoRefresh = false);
+
+    /** resolve callable by dotted @b name in @b scope module, object or dict */
+    Function(PyObject *scope, const std::wstring &name, bool autoRefresh = false);
+    Function(PyObject *scope, std::string_view name, bool autoRefresh = false);
+
+    template <typename... Args>
+    Var operator()(const Args &...args)
+    {
+      if (_autoRefresh && rebound())
+      {
+        refresh();
+      }
+      return vectorcall(_callable, args...);
+    }
+
+    /** resolve name again */
+    void refresh();
+
+    /** @return true if some name along the path now refers to another object */
+    bool rebound() const;
+
+    PyObject *callable() const { return _callable.data(); }
+
+  private:
+    std::string _name;
+    bool _autoRefresh;
+    Var _scope;
+    std::vector<Var> _keys;
+    std::vector<Var> _path;
+    Var _callable;
+  };
+
+  /**
+   * @return thread state attached to the calling thread, of main or sub-interpreter,
+   * or NULL if the thread does not hold any GIL
+   */
+  LIB_API PyThreadState *attachedThreadState();
+
+  /**
+   * @return flag of calling thread's interpreter, cleared when that interpreter is shut down.
+   * Objects outliving interpreter keep it to tell whether their python references are still valid, GIL required
+   */
+  LIB_API std::shared_ptr<std::atomic<bool>> interpreterAlive();
+
+  enum class GILLockKind
+  {
+    LOCKER,
+    SCOPED_LOCK,
+    SCOPED_RELEASE
+  };
+
+#if CPPY3_GIL_STATS
+  /** @return monotonic time in ns */
+  LIB_API uint64_t gilClock();
+
+  /** account GIL acquisition made at @b file:@b line, ScopedGILRelease has no hold time */
+  LIB_API void recordGILAcquisition(GILLockKind kind, const char *file, int line, uint64_t waitNs, uint64_t holdNs);
+#endif
+
   /**
    * GIL state scoped-lock
    * can be used recursively (like recursive mutex)
+   * does nothing if the thread is attached to interpreter already
+   * reuses thread state of enclosing ThreadAttachment, otherwise goes through PyGILState API
    */
   class LIB_API GILLocker
   {
   public:
+#if CPPY3_GIL_STATS
+    explicit GILLocker(const char *file = CPPY3_CALLER_FILE, int line = CPPY3_CALLER_LINE);
+#else
     GILLocker();
+#endif
     ~GILLocker();
 
     /** Check if the current thread is holding the GIL */
@@ -714,27 +1257,77 @@ namespace cppy3
     void lock();
     void release();
     bool _locked;
+    PyThreadState *_threadState;
     PyGILState_STATE _pyGILState;
+#if CPPY3_GIL_STATS
+    const char *_file;
+    int _line;
+    uint64_t _waitNs;
+    uint64_t _acquiredAt;
+#endif
+  };
+
+  /**
+   * Keeps thread state of the calling thread in main interpreter alive for the scope.
+   * Without it every outermost GILLocker on a thread not created by python allocates
+   * and frees PyThreadState; within it GILLocker only swaps the GIL.
+   * Hold it for lifetime of worker threads that call into python repeatedly,
+   * destroy before PythonVM. Leaves GIL as it was found. Nested attachments are no-op.
+   */
+  class LIB_API ThreadAttachment
+  {
+  public:
+    ThreadAttachment();
+    ~ThreadAttachment();
+
+    ThreadAttachment(const ThreadAttachment &) = delete;
+    ThreadAttachment &operator=(const ThreadAttachment &) = delete;
+
+    /** @return thread state kept by the innermost attachment of the calling thread or NULL */
+    static PyThreadState *current();
+
+  private:
+    bool _owner;
+    PyGILState_STATE _gilState;
   };
 
   /**
    * @brief The Scoped GIL unlocker
+   * does nothing if the thread does not hold GIL
    */
   class ScopedGILRelease
   {
   public:
+#if CPPY3_GIL_STATS
+    explicit ScopedGILRelease(const char *file = CPPY3_CALLER_FILE, int line = CPPY3_CALLER_LINE)
+        : _file(file), _line(line)
+#else
     ScopedGILRelease()
+#endif
     {
-      _threadState = PyEval_SaveThread();
+      _threadState = attachedThreadState() ? PyEval_SaveThread() : NULL;
     }
 
     ~ScopedGILRelease()
     {
-      PyEval_RestoreThread(_threadState);
+      if (_threadState)
+      {
+#if CPPY3_GIL_STATS
+        const uint64_t start = gilClock();
+        PyEval_RestoreThread(_threadState);
+        recordGILAcquisition(GILLockKind::SCOPED_RELEASE, _file, _line, gilClock() - start, 0);
+#else
+        PyEval_RestoreThread(_threadState);
+#endif
+      }
     }
 
   private:
     PyThreadState *_threadState;
+#if CPPY3_GIL_STATS
+    const char *_file;
+    int _line;
+#endif
   };
 
   /**
@@ -743,18 +1336,123 @@ namespace cppy3
   class ScopedGILLock
   {
   public:
+#if CPPY3_GIL_STATS
+    explicit ScopedGILLock(const char *file = CPPY3_CALLER_FILE, int line = CPPY3_CALLER_LINE)
+        : _file(file), _line(line)
+    {
+      const uint64_t start = gilClock();
+      _state = PyGILState_Ensure();
+      _acquiredAt = gilClock();
+      _waitNs = _acquiredAt - start;
+    }
+#else
     ScopedGILLock()
     {
       _state = PyGILState_Ensure();
     }
+#endif
 
     ~ScopedGILLock()
     {
+#if CPPY3_GIL_STATS
+      recordGILAcquisition(GILLockKind::SCOPED_LOCK, _file, _line, _waitNs, gilClock() - _acquiredAt);
+#endif
       PyGILState_Release(_state);
     }
 
   private:
     PyGILState_STATE _state;
+#if CPPY3_GIL_STATS
+    const char *_file;
+    int _line;
+    uint64_t _waitNs;
+    uint64_t _acquiredAt;
+#endif
+  };
+
+  /**
+   * std::future that releases GIL of the calling thread while waiting.
+   * Task running on another thread may need GIL to make progress
+   * (sub-interpreters of python 3.13 import extension modules through main one),
+   * so waiting with GIL held can deadlock.
+   */
+  template <typename T>
+  class Future
+  {
+  public:
+    Future() {}
+    Future(std::future<T> &&future) : _future(std::move(future)) {}
+
+    T get()
+    {
+      ScopedGILRelease release;
+      return _future.get();
+    }
+
+    void wait() const
+    {
+      ScopedGILRelease release;
+      _future.wait();
+    }
+
+    template <typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period> &timeout) const
+    {
+      ScopedGILRelease release;
+      return _future.wait_for(timeout);
+    }
+
+    bool valid() const { return _future.valid(); }
+
+  private:
+    std::future<T> _future;
   };
 
+  namespace detail
+  {
+
+    /**
+     * Package @b task to run on worker thread, result or exception goes to the future.
+     * PythonException traceback may belong to worker's (sub-)interpreter, so it is formatted before leaving
+     * @return runnable to post to worker and future of its result
+     */
+    template <typename F>
+    auto packageTask(F task) -> std::pair<std::function<void()>, Future<decltype(task())>>
+    {
+      typedef decltype(task()) Result;
+      auto packaged = std::make_shared<std::packaged_task<Result()>>([task = std::move(task)]() mutable -> Result
+      {
+        try
+        {
+          return task();
+        }
+        catch (const PythonException &e)
+        {
+          e.info.trace.lines();
+          e.what();
+          throw;
+        }
+      });
+      Future<Result> result(packaged->get_future());
+      return std::make_pair(std::function<void()>([packaged]() { (*packaged)(); }), std::move(result));
+    }
+
+    /** @return task calling callable by dotted name in __main__, result extracted to R */
+    template <typename R, typename... Args>
+    auto callTask(const std::string &callable, const Args &...args)
+    {
+      return [callable, args...]() -> R
+      {
+        const Var result = vectorcall(lookupCallable(getMainModule(), callable), args...);
+        if constexpr (!std::is_void<R>::value)
+        {
+          R value;
+          extract(result, value);
+          return value;
+        }
+      };
+    }
+
+  } // namespace detail
+
 } // namespace
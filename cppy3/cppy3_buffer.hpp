@@ -0,0 +1,214 @@
+/**
+ * N-dimensional numeric array shared with python through the buffer protocol, numpy not required
+ *
+ * Python sees the array as memoryview of C++ owned memory, usable by anything consuming buffers
+ * (memoryview indexing and tolist(), array, struct, numpy.asarray when present) without copies.
+ * Buffers exported by python objects are viewed from C++ the same way.
+ */
+#pragma once
+
+#include "cppy3.hpp"
+#include "cppy3_pool.hpp"
+
+#include <cassert>
+#include <memory>
+#include <vector>
+
+namespace cppy3
+{
+
+  template <typename T>
+  class BufferArray
+  {
+  public:
+    static_assert(std::is_arithmetic<T>::value, "numeric element type expected");
+
+    BufferArray() : _data(NULL), _readonly(false)
+    {
+    }
+
+    /**
+     * Zero filled C-contiguous array owned by C++ and python views of it
+     * @param shape - size of each dimension
+     */
+    explicit BufferArray(const std::vector<Py_ssize_t> &shape) : BufferArray()
+    {
+      const std::shared_ptr<T> block(new T[elements(shape)](), std::default_delete<T[]>());
+      assign(block.get(), shape, block, std::vector<Py_ssize_t>());
+    }
+
+    /**
+     * C-contiguous array in memory of @b pool, block returns to pool with last view of array
+     */
+    BufferArray(const std::vector<Py_ssize_t> &shape, BufferPool &pool) : BufferArray()
+    {
+      const std::shared_ptr<void> block = pool.allocate(elements(shape) * sizeof(T));
+      assign(static_cast<T *>(block.get()), shape, block, std::vector<Py_ssize_t>());
+    }
+
+    /**
+     * Existing memory without copying, @b owner keeps data alive as long as array or any python view of it
+     * @param strides - distance between elements of each dimension in bytes, C-contiguous if empty
+     */
+    BufferArray(T *data, const std::vector<Py_ssize_t> &shape, const std::shared_ptr<void> &owner,
+                const std::vector<Py_ssize_t> &strides = std::vector<Py_ssize_t>())
+        : BufferArray()
+    {
+      assign(data, shape, owner, strides);
+    }
+
+    /**
+     * View buffer exported by python object (memoryview, array.array, bytearray, numpy.ndarray ...) without copying.
+     * Exporter is kept alive and locked against resizing while the array exists, GIL required.
+     * Throws PythonException if object exports no buffer of T elements
+     */
+    explicit BufferArray(PyObject *o) : BufferArray()
+    {
+      std::unique_ptr<Py_buffer> view(new Py_buffer());
+      bool writable = true;
+      if (PyObject_GetBuffer(o, view.get(), PyBUF_RECORDS) != 0)
+      {
+        PyErr_Clear();
+        writable = false;
+        if (PyObject_GetBuffer(o, view.get(), PyBUF_RECORDS_RO) != 0)
+        {
+          rethrowPythonException();
+        }
+      }
+      if (view->itemsize != sizeof(T) || !bufferFormatMatches(view->format ? view->format : "B", bufferFormat<T>()))
+      {
+        const std::string format = view->format ? view->format : "B";
+        PyBuffer_Release(view.get());
+        throw PythonException("buffer of format '" + format + "' does not hold elements of format '" + bufferFormat<T>() + "'");
+      }
+
+      const std::vector<Py_ssize_t> shape(view->shape, view->shape + view->ndim);
+      const std::vector<Py_ssize_t> strides(view->strides, view->strides + view->ndim);
+      T *data = static_cast<T *>(view->buf);
+      const std::shared_ptr<std::atomic<bool>> interpreter = interpreterAlive();
+      const std::shared_ptr<Py_buffer> exporter(view.release(), [interpreter](Py_buffer *v) {
+        if (*interpreter && Py_IsInitialized())
+        {
+          GILLocker lock;
+          PyBuffer_Release(v);
+        }
+        else if (*interpreter && attachedThreadState())
+        {
+          // last python view dropped while finalizing, finalizing thread holds GIL
+          PyBuffer_Release(v);
+        }
+        // else interpreter is gone together with exporter, nothing left to release
+        delete v;
+      });
+      assign(data, shape, exporter, strides);
+      _readonly = !writable;
+    }
+
+    /**
+     * Element at index, one index per dimension
+     */
+    template <typename... Index>
+    const T &operator()(Index... index) const
+    {
+      return *element(index...);
+    }
+
+    /**
+     * Writable element at index, array must not view read-only buffer
+     */
+    template <typename... Index>
+    T &operator()(Index... index)
+    {
+      assert(!_readonly);
+      return *element(index...);
+    }
+
+    T *data() const { return _data; }
+    const std::vector<Py_ssize_t> &shape() const { return _shape; }
+    /** @return distance between elements of each dimension in bytes */
+    const std::vector<Py_ssize_t> &strides() const { return _strides; }
+    size_t ndim() const { return _shape.size(); }
+    /** @return number of elements */
+    size_t size() const { return _data ? elements(_shape) : 0; }
+    /** @return true when viewing read-only python buffer, e.g. bytes, its elements are read through const array */
+    bool readonly() const { return _readonly; }
+    /** @return memory owner shared with python views */
+    const std::shared_ptr<void> &owner() const { return _owner; }
+
+    /** @return true when elements are dense in C order, so data() can be walked as flat array of size() */
+    bool contiguous() const
+    {
+      Py_ssize_t expected = sizeof(T);
+      for (size_t d = _shape.size(); d-- > 0;)
+      {
+        if (_shape[d] != 1 && _strides[d] != expected)
+        {
+          return false;
+        }
+        expected *= _shape[d];
+      }
+      return true;
+    }
+
+  private:
+    template <typename... Index>
+    T *element(Index... index) const
+    {
+      assert(sizeof...(Index) == _shape.size());
+      char *p = reinterpret_cast<char *>(_data);
+      size_t d = 0;
+      ((assert(static_cast<Py_ssize_t>(index) >= 0 && static_cast<Py_ssize_t>(index) < _shape[d]),
+        p += static_cast<Py_ssize_t>(index) * _strides[d++]),
+       ...);
+      (void)d;
+      return reinterpret_cast<T *>(p);
+    }
+
+    static size_t elements(const std::vector<Py_ssize_t> &shape)
+    {
+      size_t n = 1;
+      for (Py_ssize_t s : shape)
+      {
+        assert(s >= 0);
+        n *= static_cast<size_t>(s);
+      }
+      return n;
+    }
+
+    void assign(T *data, const std::vector<Py_ssize_t> &shape, const std::shared_ptr<void> &owner, const std::vector<Py_ssize_t> &strides)
+    {
+      assert(strides.empty() || strides.size() == shape.size());
+      _data = data;
+      _shape = shape;
+      _owner = owner;
+      _strides = strides;
+      if (_strides.empty())
+      {
+        _strides.resize(shape.size());
+        Py_ssize_t stride = sizeof(T);
+        for (size_t d = shape.size(); d-- > 0;)
+        {
+          _strides[d] = stride;
+          stride *= shape[d];
+        }
+      }
+    }
+
+    T *_data;
+    std::vector<Py_ssize_t> _shape;
+    std::vector<Py_ssize_t> _strides;
+    std::shared_ptr<void> _owner;
+    bool _readonly;
+  };
+
+  /**
+   * @return new reference to memoryview sharing memory of @b value, python views keep memory alive
+   */
+  template <typename T>
+  PyObject *convert(const BufferArray<T> &value)
+  {
+    assert(value.data());
+    return convertBuffer(value.data(), value.shape(), sizeof(T), bufferFormat<T>(), value.owner(), value.readonly(), value.strides());
+  }
+
+} // namespace
@@ -0,0 +1,425 @@
+/**
+ * Export C++ classes to python
+ *
+ * Class builder generates heap type per interpreter. Instances have fixed layout without __dict__,
+ * like __slots__ classes: fields are data descriptors reading C++ members through member pointer,
+ * attribute access costs no dict lookup in the instance and no conversion of other fields.
+ */
+#pragma once
+
+#include "cppy3_module.hpp"
+
+#include <deque>
+#include <mutex>
+#include <set>
+
+namespace cppy3
+{
+
+  namespace detail
+  {
+
+    /**
+     * Python instance of exported C++ class.
+     * Either owns value in place or views C++ object, optionally sharing its ownership
+     */
+    template <typename T>
+    struct ClassObject
+    {
+      PyObject_HEAD
+      T *ptr;
+      std::shared_ptr<void> owner;
+      bool owned;
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type value;
+
+      /** @return new instance of @b type without C++ object attached */
+      static ClassObject *alloc(PyTypeObject *type)
+      {
+        ClassObject *self = reinterpret_cast<ClassObject *>(type->tp_alloc(type, 0));
+        if (self)
+        {
+          new (&self->owner) std::shared_ptr<void>();
+          self->ptr = NULL;
+          self->owned = false;
+        }
+        return self;
+      }
+
+      static void dealloc(PyObject *o)
+      {
+        ClassObject *self = reinterpret_cast<ClassObject *>(o);
+        if (self->owned)
+        {
+          self->ptr->~T();
+        }
+        self->owner.~shared_ptr();
+        PyTypeObject *type = Py_TYPE(o);
+        type->tp_free(o);
+        Py_DECREF(type);
+      }
+
+      /** @return C++ object of @b o or NULL if it is not instance of this class */
+      static T *get(PyObject *o)
+      {
+        // dealloc is instantiated once per T, so it identifies type in every interpreter
+        return o && Py_TYPE(o)->tp_dealloc == &dealloc ? reinterpret_cast<ClassObject *>(o)->ptr : NULL;
+      }
+
+      static PyObject *create(PyTypeObject *type, PyObject *, PyObject *)
+      {
+        if constexpr (std::is_default_constructible<T>::value)
+        {
+          ClassObject *self = alloc(type);
+          if (self)
+          {
+            try
+            {
+              self->ptr = new (&self->value) T();
+              self->owned = true;
+            }
+            catch (...)
+            {
+              Py_DECREF(self);
+              PyErr_Format(PyExc_RuntimeError, "%s(): %s", type->tp_name, describe(std::current_exception()).c_str());
+              return NULL;
+            }
+          }
+          return reinterpret_cast<PyObject *>(self);
+        }
+        else
+        {
+          PyErr_Format(PyExc_TypeError, "cannot create '%s' instances", type->tp_name);
+          return NULL;
+        }
+      }
+
+      /** fields can be initialized by keyword: Order(id=1, price=2.5) */
+      static int init(PyObject *self, PyObject *args, PyObject *kwds)
+      {
+        if (args && PyTuple_GET_SIZE(args) > 0)
+        {
+          PyErr_Format(PyExc_TypeError, "%s() takes keyword arguments only", Py_TYPE(self)->tp_name);
+          return -1;
+        }
+        PyObject *key = NULL;
+        PyObject *value = NULL;
+        Py_ssize_t pos = 0;
+        while (kwds && PyDict_Next(kwds, &pos, &key, &value))
+        {
+          if (PyObject_SetAttr(self, key, value) != 0)
+          {
+            return -1;
+          }
+        }
+        return 0;
+      }
+    };
+
+    template <typename T, typename V>
+    struct FieldAccess
+    {
+      V T::*member;
+      std::string name;
+
+      static PyObject *get(PyObject *self, void *closure)
+      {
+        const FieldAccess *field = static_cast<const FieldAccess *>(closure);
+        const T *object = reinterpret_cast<ClassObject<T> *>(self)->ptr;
+        return toPython<V>(object->*(field->member));
+      }
+
+      static int set(PyObject *self, PyObject *value, void *closure)
+      {
+        const FieldAccess *field = static_cast<const FieldAccess *>(closure);
+        if (value == NULL)
+        {
+          PyErr_Format(PyExc_AttributeError, "cannot delete attribute '%s'", field->name.c_str());
+          return -1;
+        }
+        try
+        {
+          reinterpret_cast<ClassObject<T> *>(self)->ptr->*(field->member) = fromPython<V>(value);
+          return 0;
+        }
+        catch (...)
+        {
+          PyErr_Format(PyExc_TypeError, "attribute '%s': %s", field->name.c_str(), describe(std::current_exception()).c_str());
+          return -1;
+        }
+      }
+    };
+
+  } // namespace detail
+
+  /**
+   * C++ method exported to python, first argument of callable is T& or const T& receiving self
+   */
+  template <typename T, typename F>
+  class ExportedMethod : public ExportedFunction
+  {
+  public:
+    typedef detail::CallableTraits<typename std::decay<F>::type> Traits;
+    static_assert(Traits::arity > 0 && std::is_same<typename std::tuple_element<0, typename Traits::Arguments>::type, T>::value,
+                  "method takes T& as first argument");
+
+    ExportedMethod(const std::string &name, F function, std::vector<std::string> argNames, const std::string &doc)
+        : ExportedFunction(name, Traits::arity, withSelf(argNames), doc), _function(std::move(function))
+    {
+    }
+
+    PyObject *call(PyObject *const *args) override
+    {
+      return call(args, std::make_index_sequence<Traits::arity - 1>());
+    }
+
+  private:
+    static std::vector<std::string> withSelf(std::vector<std::string> argNames)
+    {
+      argNames.insert(argNames.begin(), "self");
+      return argNames;
+    }
+
+    template <size_t... I>
+    PyObject *call(PyObject *const *args, std::index_sequence<I...>)
+    {
+      T *self = detail::ClassObject<T>::get(args[0]);
+      if (self == NULL)
+      {
+        PyErr_Format(PyExc_TypeError, "%s() requires instance of its class as self", name().c_str());
+        return NULL;
+      }
+      size_t argument = 0;
+      try
+      {
+        std::tuple<typename std::tuple_element<I + 1, typename Traits::Arguments>::type...> values{
+            (argument = I + 1, detail::fromPython<typename std::tuple_element<I + 1, typename Traits::Arguments>::type>(args[I + 1]))...};
+        argument = NO_ARGUMENT;
+        if constexpr (std::is_void<typename Traits::Result>::value)
+        {
+          _function(*self, std::get<I>(values)...);
+          Py_RETURN_NONE;
+        }
+        else
+        {
+          return detail::toPython<typename std::decay<typename Traits::Result>::type>(_function(*self, std::get<I>(values)...));
+        }
+      }
+      catch (...)
+      {
+        raise(std::current_exception(), argument);
+        return NULL;
+      }
+    }
+
+    F _function;
+  };
+
+  /**
+   * C++ class exported to python as heap type of Module
+   *
+   *   const cppy3::Class<Order> order = cppy3::Class<Order>("Order", "Limit order.")
+   *     .field("price", &Order::price)
+   *     .readonly("id", &Order::id)
+   *     .method("notional", [](const Order &o, long qty) { return o.price * qty; }, {"qty"});
+   *   cppy3::Module("market").type(order).install();
+   *
+   *   Var a = order.instance(Order{1, 100.5});  // python object owning copy
+   *   Var b = order.view(book.front());         // zero-copy view, C++ object must outlive it
+   *   Var c = order.view(sharedOrder);          // zero-copy view sharing ownership
+   *
+   * Default constructible classes can be created in python, fields are then initialized by keyword.
+   * Field types are those supported by module functions. Definition is complete once module is created,
+   * copies of builder share it. Python sees C++ objects unsynchronized, as C++ code does.
+   */
+  template <typename T>
+  class Class
+  {
+  public:
+    explicit Class(const std::string &name, const std::string &doc = std::string()) : _definition(std::make_shared<Definition>())
+    {
+      _definition->className = name;
+      _definition->classDoc = doc;
+    }
+
+    /** expose @b member as read-write attribute */
+    template <typename V>
+    Class &field(const std::string &name, V T::*member, const std::string &doc = std::string())
+    {
+      _definition->addField(name, member, doc, true);
+      return *this;
+    }
+
+    /** expose @b member as read-only attribute */
+    template <typename V>
+    Class &readonly(const std::string &name, V T::*member, const std::string &doc = std::string())
+    {
+      _definition->addField(name, member, doc, false);
+      return *this;
+    }
+
+    /**
+     * Export @b function taking T& or const T& and arguments as method
+     * @param argNames - names of leading arguments after self, allow passing them by keyword
+     */
+    template <typename F>
+    Class &method(const std::string &name, F function, const std::vector<std::string> &argNames = std::vector<std::string>(),
+                  const std::string &doc = std::string())
+    {
+      _definition->check(name);
+      _definition->methods.push_back(std::make_shared<ExportedMethod<T, F>>(name, std::move(function), argNames, doc));
+      return *this;
+    }
+
+    /** @return python instance owning copy of @b value, GIL required */
+    Var instance(T value) const
+    {
+      detail::ClassObject<T> *self = detail::ClassObject<T>::alloc(_definition->exportedType());
+      if (self == NULL)
+      {
+        rethrowPythonException();
+      }
+      Var o = Var::from(reinterpret_cast<PyObject *>(self));
+      self->ptr = new (&self->value) T(std::move(value));
+      self->owned = true;
+      return o;
+    }
+
+    /** @return python view of @b object, it must outlive the view; GIL required */
+    Var view(T &object) const
+    {
+      return view(&object, std::shared_ptr<void>());
+    }
+
+    /** @return python view of @b object, keeping it alive; GIL required */
+    Var view(const std::shared_ptr<T> &object) const
+    {
+      return view(object.get(), object);
+    }
+
+    /** @return C++ object of python instance or view, NULL if @b o is not instance of this class */
+    static T *get(PyObject *o)
+    {
+      return detail::ClassObject<T>::get(o);
+    }
+
+    const std::string &name() const { return _definition->className; }
+
+    /** used by Module::type() */
+    std::shared_ptr<ExportedClass> definition() const { return _definition; }
+
+  private:
+    struct Definition : public ExportedClass
+    {
+      std::string className;
+      std::string classDoc;
+      /** closures of fields, referenced by getset */
+      std::deque<std::shared_ptr<void>> fields;
+      std::vector<PyGetSetDef> getset;
+      std::vector<std::shared_ptr<ExportedFunction>> methods;
+      /** "module.Name" of created types, type keeps pointer to it */
+      std::set<std::string> qualifiedNames;
+      std::mutex mutex;
+      bool complete = false;
+
+      const std::string &name() const override { return className; }
+
+      void check(const std::string &attribute)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (complete)
+        {
+          throw PythonException(className + "." + attribute + ": class is already exported");
+        }
+      }
+
+      template <typename V>
+      void addField(const std::string &attribute, V T::*member, const std::string &fieldDoc, bool writable)
+      {
+        check(attribute);
+        typedef detail::FieldAccess<T, V> Access;
+        auto field = std::make_shared<Access>(Access{member, attribute});
+        fields.push_back(field);
+        getset.push_back({field->name.c_str(), &Access::get, writable ? &Access::set : NULL, NULL, field.get()});
+        if (!fieldDoc.empty())
+        {
+          fields.push_back(std::make_shared<std::string>(fieldDoc));
+          getset.back().doc = static_cast<std::string *>(fields.back().get())->c_str();
+        }
+      }
+
+      PyObject *createType(PyObject *module) override
+      {
+        const char *moduleName = PyModule_GetName(module);
+        if (moduleName == NULL)
+        {
+          return NULL;
+        }
+        const char *qualifiedName = NULL;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!complete)
+          {
+            getset.push_back({NULL, NULL, NULL, NULL, NULL});
+            complete = true;
+          }
+          qualifiedName = qualifiedNames.insert(std::string(moduleName) + "." + className).first->c_str();
+        }
+
+        std::vector<PyType_Slot> slots = {
+            {Py_tp_new, reinterpret_cast<void *>(&detail::ClassObject<T>::create)},
+            {Py_tp_init, reinterpret_cast<void *>(&detail::ClassObject<T>::init)},
+            {Py_tp_dealloc, reinterpret_cast<void *>(&detail::ClassObject<T>::dealloc)},
+            {Py_tp_getset, getset.data()}};
+        if (!classDoc.empty())
+        {
+          slots.push_back({Py_tp_doc, const_cast<char *>(classDoc.c_str())});
+        }
+        slots.push_back({0, NULL});
+        PyType_Spec spec = {qualifiedName, sizeof(detail::ClassObject<T>), 0, Py_TPFLAGS_DEFAULT, slots.data()};
+        Var type = Var::from(PyType_FromSpec(&spec));
+        if (type.null())
+        {
+          return NULL;
+        }
+
+        const Var moduleNameObject = Var::from(PyUnicode_FromString(moduleName));
+        for (const auto &method : methods)
+        {
+          const Var function = Var::from(ExportedFunction::newFunction(method, moduleNameObject));
+          // instancemethod binds self like python function does
+          const Var bound = Var::from(function.null() ? NULL : PyInstanceMethod_New(function));
+          if (bound.null() || PyObject_SetAttrString(type, method->name().c_str(), bound) != 0)
+          {
+            return NULL;
+          }
+        }
+        return type.release();
+      }
+
+      PyTypeObject *exportedType() const
+      {
+        PyObject *t = type();
+        if (t == NULL)
+        {
+          throw PythonException("class " + className + " is not exported to this interpreter");
+        }
+        return reinterpret_cast<PyTypeObject *>(t);
+      }
+    };
+
+    Var view(T *object, const std::shared_ptr<void> &owner) const
+    {
+      detail::ClassObject<T> *self = detail::ClassObject<T>::alloc(_definition->exportedType());
+      if (self == NULL)
+      {
+        rethrowPythonException();
+      }
+      self->ptr = object;
+      self->owner = owner;
+      return Var::from(reinterpret_cast<PyObject *>(self));
+    }
+
+    std::shared_ptr<Definition> _definition;
+  };
+
+} // namespace
@@ -0,0 +1,94 @@
+/**
+ * Minimal DLPack ABI (v0.8 DLManagedTensor) for zero-copy tensor exchange, see https://github.com/dmlc/dlpack
+ *
+ * Declarations match dlpack.h; when it is included before this header, its definitions are used instead.
+ */
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <type_traits>
+
+#ifndef DLPACK_DLPACK_H_
+
+extern "C"
+{
+  typedef enum
+  {
+    kDLCPU = 1,
+    kDLCUDA = 2,
+    kDLCUDAHost = 3,
+  } DLDeviceType;
+
+  typedef struct
+  {
+    DLDeviceType device_type;
+    int32_t device_id;
+  } DLDevice;
+
+  typedef enum
+  {
+    kDLInt = 0U,
+    kDLUInt = 1U,
+    kDLFloat = 2U,
+    kDLOpaqueHandle = 3U,
+    kDLBfloat = 4U,
+    kDLComplex = 5U,
+    kDLBool = 6U,
+  } DLDataTypeCode;
+
+  typedef struct
+  {
+    uint8_t code;
+    uint8_t bits;
+    uint16_t lanes;
+  } DLDataType;
+
+  typedef struct
+  {
+    void *data;
+    DLDevice device;
+    int32_t ndim;
+    DLDataType dtype;
+    int64_t *shape;
+    /** in elements, NULL for C-contiguous */
+    int64_t *strides;
+    uint64_t byte_offset;
+  } DLTensor;
+
+  typedef struct DLManagedTensor
+  {
+    DLTensor dl_tensor;
+    void *manager_ctx;
+    void (*deleter)(struct DLManagedTensor *self);
+  } DLManagedTensor;
+}
+
+#endif
+
+namespace cppy3
+{
+
+  struct float16;
+
+  /**
+   * DLPack data type of C++ element type
+   */
+  template <typename T>
+  DLDataType dlpackType()
+  {
+    const uint8_t bits = sizeof(T) * 8;
+    if constexpr (std::is_same<T, bool>::value)
+      return DLDataType{kDLBool, 8, 1};
+    else if constexpr (std::is_same<T, float16>::value || std::is_floating_point<T>::value)
+      return DLDataType{kDLFloat, bits, 1};
+    else if constexpr (std::is_same<T, std::complex<float>>::value || std::is_same<T, std::complex<double>>::value)
+      return DLDataType{kDLComplex, bits, 1};
+    else
+    {
+      static_assert(std::is_integral<T>::value, "no DLPack data type for element type");
+      return DLDataType{std::is_signed<T>::value ? kDLInt : kDLUInt, bits, 1};
+    }
+  }
+
+} // namespace
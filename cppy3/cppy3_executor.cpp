@@ -0,0 +1,281 @@
+#include "cppy3_executor.hpp"
+#include "cppy3_subinterpreters.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <thread>
+
+namespace cppy3
+{
+
+  namespace
+  {
+
+    /** worker of which executor runs on this thread */
+    thread_local const Executor *currentExecutor = NULL;
+    thread_local size_t currentWorker = 0;
+
+    /** Interpreter a worker thread attaches to for each batch */
+    class WorkerInterpreter
+    {
+    public:
+      explicit WorkerInterpreter(bool ownGIL)
+      {
+        if (ownGIL)
+        {
+#if CPPY3_HAVE_SUBINTERPRETERS
+          _interpreter.reset(new SubInterpreter());
+#else
+          throw PythonException("executor with own GIL requires python 3.12+");
+#endif
+        }
+        else
+        {
+          // thread state is created once, not per batch
+          _attachment.reset(new ThreadAttachment());
+        }
+      }
+
+      void attach()
+      {
+#if CPPY3_HAVE_SUBINTERPRETERS
+        if (_interpreter)
+        {
+          _interpreter->attach();
+          return;
+        }
+#endif
+        PyEval_RestoreThread(ThreadAttachment::current());
+      }
+
+      void detach()
+      {
+#if CPPY3_HAVE_SUBINTERPRETERS
+        if (_interpreter)
+        {
+          _interpreter->detach();
+          return;
+        }
+#endif
+        PyEval_SaveThread();
+      }
+
+    private:
+#if CPPY3_HAVE_SUBINTERPRETERS
+      std::unique_ptr<SubInterpreter> _interpreter;
+#endif
+      std::unique_ptr<ThreadAttachment> _attachment;
+    };
+
+  } // namespace
+
+  struct Executor::Worker
+  {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+
+    /** owner takes from the front, in order of submission */
+    std::function<void()> pop()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::function<void()> task;
+      if (!tasks.empty())
+      {
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      return task;
+    }
+
+    /** thieves take from the back, away from the owner */
+    std::function<void()> steal()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::function<void()> task;
+      if (!tasks.empty())
+      {
+        task = std::move(tasks.back());
+        tasks.pop_back();
+      }
+      return task;
+    }
+  };
+
+  LIB_API Executor::Executor() : Executor(Options())
+  {
+  }
+
+  LIB_API Executor::Executor(const Options &options)
+      : _options(options), _stop(false), _pending(0), _next(0), _tasks(0), _batches(0), _steals(0)
+  {
+    assert(Py_IsInitialized());
+    if (!_options.ownGIL && !_options.setup.empty())
+    {
+      GILLocker lock;
+      exec(_options.setup);
+    }
+    start();
+  }
+
+  LIB_API Executor::~Executor()
+  {
+    ScopedGILRelease release;
+    shutdown();
+  }
+
+  void Executor::start()
+  {
+    const size_t size = _options.threads ? _options.threads : std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < size; ++i)
+    {
+      _workers.emplace_back(new Worker());
+    }
+
+    // workers need GIL of main interpreter to set up
+    ScopedGILRelease release;
+    try
+    {
+      for (size_t i = 0; i < size; ++i)
+      {
+        std::promise<void> started;
+        std::future<void> ready = started.get_future();
+        _workers[i]->thread = std::thread([this, i, &started]() { run(i, started); });
+        ready.get();
+      }
+    }
+    catch (...)
+    {
+      shutdown();
+      throw;
+    }
+  }
+
+  void Executor::shutdown()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_sleepMutex);
+      _stop = true;
+    }
+    _wake.notify_all();
+    for (auto &worker : _workers)
+    {
+      if (worker->thread.joinable())
+      {
+        worker->thread.join();
+      }
+    }
+  }
+
+  void Executor::post(size_t worker, std::function<void()> task)
+  {
+    if (worker == NO_WORKER)
+    {
+      worker = currentExecutor == this ? currentWorker : _next++ % _workers.size();
+    }
+    assert(worker < _workers.size());
+    Worker &w = *_workers[worker];
+    {
+      std::lock_guard<std::mutex> lock(w.mutex);
+      // counted before the task is visible to thieves, so their decrement never comes first
+      _pending++;
+      w.tasks.push_back(std::move(task));
+    }
+    {
+      // sleeping worker checks _pending under this mutex, so wake-up is not lost
+      std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    _wake.notify_one();
+  }
+
+  std::function<void()> Executor::next(size_t worker)
+  {
+    std::function<void()> task = _workers[worker]->pop();
+    for (size_t i = 1; !task && i < _workers.size(); ++i)
+    {
+      task = _workers[(worker + i) % _workers.size()]->steal();
+      if (task)
+      {
+        _steals++;
+      }
+    }
+    if (task)
+    {
+      _pending--;
+    }
+    return task;
+  }
+
+  void Executor::run(size_t worker, std::promise<void> &started)
+  {
+    std::unique_ptr<WorkerInterpreter> interpreter;
+    try
+    {
+      interpreter.reset(new WorkerInterpreter(_options.ownGIL));
+      if (_options.ownGIL && !_options.setup.empty())
+      {
+        interpreter->attach();
+        try
+        {
+          exec(_options.setup);
+        }
+        catch (const PythonException &e)
+        {
+          e.info.trace.lines();
+          e.what();
+          interpreter->detach();
+          throw;
+        }
+        interpreter->detach();
+      }
+    }
+    catch (...)
+    {
+      started.set_exception(std::current_exception());
+      return;
+    }
+    started.set_value();
+
+    currentExecutor = this;
+    currentWorker = worker;
+    for (;;)
+    {
+      std::function<void()> task = next(worker);
+      if (!task)
+      {
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this]() { return _stop || _pending > 0; });
+        if (_stop && _pending == 0)
+        {
+          break;
+        }
+        continue;
+      }
+
+      // keep GIL while there are queued tasks, up to maxBatch
+      interpreter->attach();
+      _batches++;
+      size_t done = 0;
+      do
+      {
+        task();
+        // captured python objects are released with GIL held
+        task = nullptr;
+        _tasks++;
+      } while (++done < _options.maxBatch && (task = next(worker)));
+      interpreter->detach();
+    }
+    currentExecutor = NULL;
+  }
+
+  LIB_API Executor::Stats Executor::stats() const
+  {
+    Stats s;
+    s.tasks = _tasks;
+    s.batches = _batches;
+    s.steals = _steals;
+    return s;
+  }
+
+} // namespace
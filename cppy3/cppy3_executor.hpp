@@ -0,0 +1,116 @@
+/**
+ * Work-stealing executor for python tasks
+ *
+ * Worker attaches to interpreter once per batch of queued tasks instead of once per task,
+ * so a burst of small tasks does not bounce GIL between threads.
+ * Every worker has own deque, idle workers steal from the busy ones.
+ */
+#pragma once
+
+#include "cppy3.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cppy3
+{
+
+  class LIB_API Executor
+  {
+  public:
+    struct Options
+    {
+      /** number of workers, 0 for number of hardware threads */
+      size_t threads = 0;
+
+      /**
+       * Run every worker in own sub-interpreter with own GIL (python 3.12+)
+       * Tasks must take and return C++ values only, as they may run in any of interpreters.
+       */
+      bool ownGIL = false;
+
+      /** max number of tasks run per one GIL acquisition */
+      size_t maxBatch = 64;
+
+      /** script executed before the first task: in each sub-interpreter, or once in __main__ of shared one */
+      std::string setup;
+    };
+
+    struct Stats
+    {
+      size_t tasks;
+      size_t batches;
+      size_t steals;
+    };
+
+    Executor();
+    explicit Executor(const Options &options);
+
+    /** runs queued tasks, then stops workers. Must be destroyed before PythonVM */
+    ~Executor();
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    size_t size() const { return _workers.size(); }
+
+    /**
+     * Queue @b task, round-robin across workers or to own deque when called from a worker.
+     * PythonException thrown by a task is forwarded through the future with traceback already formatted.
+     */
+    template <typename F>
+    auto submit(F task) -> Future<decltype(task())>
+    {
+      return submit(NO_WORKER, std::move(task));
+    }
+
+    /** queue @b task to deque of @b worker, it still may be stolen by another worker */
+    template <typename F>
+    auto submit(size_t worker, F task) -> Future<decltype(task())>
+    {
+      auto packaged = detail::packageTask(std::move(task));
+      post(worker, std::move(packaged.first));
+      return std::move(packaged.second);
+    }
+
+    /**
+     * Call callable by dotted name in __main__
+     * @return future of result extracted to R
+     */
+    template <typename R, typename... Args>
+    Future<R> call(const std::string &callable, const Args &...args)
+    {
+      return submit(detail::callTask<R>(callable, args...));
+    }
+
+    Stats stats() const;
+
+  private:
+    struct Worker;
+    static const size_t NO_WORKER = static_cast<size_t>(-1);
+
+    void start();
+    void post(size_t worker, std::function<void()> task);
+    std::function<void()> next(size_t worker);
+    void run(size_t worker, std::promise<void> &started);
+    void shutdown();
+
+    const Options _options;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+    bool _stop;
+    std::atomic<size_t> _pending;
+    std::atomic<size_t> _next;
+    std::atomic<size_t> _tasks;
+    std::atomic<size_t> _batches;
+    std::atomic<size_t> _steals;
+  };
+
+} // namespace
@@ -0,0 +1,368 @@
+#include "cppy3_gilstats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+namespace cppy3
+{
+
+  namespace
+  {
+
+#if CPPY3_GIL_STATS
+    typedef std::tuple<const char *, int, GILLockKind> SiteKey;
+
+    struct SiteRecord
+    {
+      GILHistogram wait;
+      GILHistogram hold;
+    };
+
+    /** samples of one thread, its own lock is taken by the owner and by snapshots only */
+    struct ThreadRecord
+    {
+      std::mutex mutex;
+      std::string thread;
+      std::map<SiteKey, SiteRecord> sites;
+    };
+
+    /** lock order: registry, then thread record */
+    struct Registry
+    {
+      std::mutex mutex;
+      std::vector<ThreadRecord *> threads;
+      /** samples of exited threads folded together, so thread churn does not grow the registry */
+      std::map<SiteKey, SiteRecord> exitedSites;
+    };
+
+    Registry &registry()
+    {
+      // never destroyed, threads may record during static destruction
+      static Registry *instance = new Registry();
+      return *instance;
+    }
+
+    /** thread's record, folded into exited threads aggregate when the thread ends */
+    struct ThreadSlot
+    {
+      std::unique_ptr<ThreadRecord> record;
+
+      ~ThreadSlot();
+    };
+
+    // trivially destructible, valid while slot is being destroyed and after
+    thread_local bool threadExited = false;
+
+    ThreadSlot::~ThreadSlot()
+    {
+      threadExited = true;
+      if (!record)
+      {
+        return;
+      }
+      Registry &r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.threads.erase(std::find(r.threads.begin(), r.threads.end(), record.get()));
+      std::lock_guard<std::mutex> recordLock(record->mutex);
+      for (const auto &site : record->sites)
+      {
+        SiteRecord &total = r.exitedSites[site.first];
+        total.wait.merge(site.second.wait);
+        total.hold.merge(site.second.hold);
+      }
+    }
+
+    /** @return record of calling thread or NULL once its thread-local storage is being destroyed */
+    ThreadRecord *threadRecord()
+    {
+      if (threadExited)
+      {
+        return NULL;
+      }
+      thread_local ThreadSlot slot;
+      if (!slot.record)
+      {
+        slot.record.reset(new ThreadRecord());
+        std::ostringstream id;
+        id << std::this_thread::get_id();
+        slot.record->thread = id.str();
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.push_back(slot.record.get());
+      }
+      return slot.record.get();
+    }
+
+    /** merge thread's @b sites into per-site @b totals and @b thread summary */
+    void collect(const std::map<SiteKey, SiteRecord> &sites, std::map<std::tuple<std::string, int, GILLockKind>, SiteRecord> &totals,
+                 GILThreadStats &thread)
+    {
+      for (const auto &site : sites)
+      {
+        SiteRecord &total = totals[std::make_tuple(std::string(std::get<0>(site.first)), std::get<1>(site.first), std::get<2>(site.first))];
+        total.wait.merge(site.second.wait);
+        total.hold.merge(site.second.hold);
+        thread.acquisitions += site.second.wait.count;
+        thread.waitNs += site.second.wait.totalNs;
+        thread.holdNs += site.second.hold.totalNs;
+      }
+    }
+#endif
+
+    std::string jsonString(const std::string &text)
+    {
+      std::ostringstream out;
+      out << '"';
+      for (const char c : text)
+      {
+        if (c == '"' || c == '\\')
+        {
+          out << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+          out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+        }
+        else
+        {
+          out << c;
+        }
+      }
+      out << '"';
+      return out.str();
+    }
+
+    void writeJSON(std::ostream &out, const GILHistogram &h)
+    {
+      out << "{\"count\":" << h.count << ",\"total_ns\":" << h.totalNs << ",\"max_ns\":" << h.maxNs
+          << ",\"p50_ns\":" << h.quantile(0.5) << ",\"p99_ns\":" << h.quantile(0.99) << ",\"buckets\":[";
+      size_t used = GILHistogram::BUCKETS;
+      while (used > 0 && h.buckets[used - 1] == 0)
+      {
+        --used;
+      }
+      for (size_t i = 0; i < used; ++i)
+      {
+        out << (i ? "," : "") << h.buckets[i];
+      }
+      out << "]}";
+    }
+
+    double micros(uint64_t ns)
+    {
+      return ns / 1000.0;
+    }
+
+  } // namespace
+
+  LIB_API void GILHistogram::add(uint64_t ns)
+  {
+    size_t bucket = 0;
+    for (uint64_t v = ns; v && bucket < BUCKETS - 1; v >>= 1)
+    {
+      ++bucket;
+    }
+    ++buckets[bucket];
+    ++count;
+    totalNs += ns;
+    maxNs = std::max(maxNs, ns);
+  }
+
+  LIB_API void GILHistogram::merge(const GILHistogram &other)
+  {
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+      buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    totalNs += other.totalNs;
+    maxNs = std::max(maxNs, other.maxNs);
+  }
+
+  LIB_API uint64_t GILHistogram::quantile(double q) const
+  {
+    if (count == 0)
+    {
+      return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+      seen += buckets[i];
+      if (seen >= rank)
+      {
+        // last bucket is open-ended
+        return i == 0 ? 0 : i == BUCKETS - 1 ? maxNs : std::min(maxNs, (uint64_t(1) << i) - 1);
+      }
+    }
+    return maxNs;
+  }
+
+  LIB_API const char *toString(GILLockKind kind)
+  {
+    switch (kind)
+    {
+    case GILLockKind::LOCKER:
+      return "GILLocker";
+    case GILLockKind::SCOPED_LOCK:
+      return "ScopedGILLock";
+    case GILLockKind::SCOPED_RELEASE:
+      return "ScopedGILRelease";
+    }
+    return "";
+  }
+
+#if CPPY3_GIL_STATS
+  LIB_API uint64_t gilClock()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  LIB_API void recordGILAcquisition(GILLockKind kind, const char *file, int line, uint64_t waitNs, uint64_t holdNs)
+  {
+    ThreadRecord *record = threadRecord();
+    if (record == NULL)
+    {
+      // lock taken by destructor of another thread-local object after the record was folded
+      return;
+    }
+    std::lock_guard<std::mutex> lock(record->mutex);
+    SiteRecord &site = record->sites[SiteKey(file, line, kind)];
+    site.wait.add(waitNs);
+    if (kind != GILLockKind::SCOPED_RELEASE)
+    {
+      site.hold.add(holdNs);
+    }
+  }
+#endif
+
+  LIB_API GILStats gilStats()
+  {
+    GILStats stats;
+#if CPPY3_GIL_STATS
+    stats.enabled = true;
+    // same site is recorded by many threads, and inline code by many translation units
+    std::map<std::tuple<std::string, int, GILLockKind>, SiteRecord> sites;
+    {
+      Registry &r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      for (ThreadRecord *record : r.threads)
+      {
+        GILThreadStats thread{record->thread, 0, 0, 0};
+        std::lock_guard<std::mutex> recordLock(record->mutex);
+        collect(record->sites, sites, thread);
+        if (thread.acquisitions)
+        {
+          stats.threads.push_back(thread);
+        }
+      }
+      GILThreadStats exited{"exited threads", 0, 0, 0};
+      collect(r.exitedSites, sites, exited);
+      if (exited.acquisitions)
+      {
+        stats.threads.push_back(exited);
+      }
+    }
+
+    for (const auto &site : sites)
+    {
+      stats.wait.merge(site.second.wait);
+      stats.hold.merge(site.second.hold);
+      stats.sites.push_back(GILSiteStats{std::get<0>(site.first), std::get<1>(site.first), std::get<2>(site.first),
+                                         site.second.wait, site.second.hold});
+    }
+    std::stable_sort(stats.sites.begin(), stats.sites.end(), [](const GILSiteStats &a, const GILSiteStats &b)
+                     { return a.wait.totalNs > b.wait.totalNs; });
+#endif
+    return stats;
+  }
+
+  LIB_API void resetGILStats()
+  {
+#if CPPY3_GIL_STATS
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (ThreadRecord *record : r.threads)
+    {
+      std::lock_guard<std::mutex> recordLock(record->mutex);
+      record->sites.clear();
+    }
+    r.exitedSites.clear();
+#endif
+  }
+
+  LIB_API std::string GILStats::toText() const
+  {
+    std::ostringstream out;
+    if (!enabled)
+    {
+      out << "GIL statistics disabled, build with CPPY3_GIL_STATS=1" << std::endl;
+      return out.str();
+    }
+    out << std::fixed << std::setprecision(1);
+    out << "GIL acquisitions: " << wait.count << std::endl
+        << "wait us: total " << micros(wait.totalNs) << ", p50 " << micros(wait.quantile(0.5))
+        << ", p99 " << micros(wait.quantile(0.99)) << ", max " << micros(wait.maxNs) << std::endl
+        << "hold us: total " << micros(hold.totalNs) << ", p50 " << micros(hold.quantile(0.5))
+        << ", p99 " << micros(hold.quantile(0.99)) << ", max " << micros(hold.maxNs) << std::endl
+        << std::endl;
+
+    out << std::left << std::setw(18) << "kind" << std::right << std::setw(10) << "count" << std::setw(14) << "wait us"
+        << std::setw(12) << "p99 wait" << std::setw(14) << "hold us" << std::setw(12) << "p99 hold" << "  site" << std::endl;
+    for (const GILSiteStats &site : sites)
+    {
+      out << std::left << std::setw(18) << toString(site.kind) << std::right << std::setw(10) << site.wait.count
+          << std::setw(14) << micros(site.wait.totalNs) << std::setw(12) << micros(site.wait.quantile(0.99))
+          << std::setw(14) << micros(site.hold.totalNs) << std::setw(12) << micros(site.hold.quantile(0.99))
+          << "  " << site.file << ":" << site.line << std::endl;
+    }
+    out << std::endl;
+
+    out << std::left << std::setw(20) << "thread" << std::right << std::setw(10) << "count" << std::setw(14) << "wait us"
+        << std::setw(14) << "hold us" << std::endl;
+    for (const GILThreadStats &thread : threads)
+    {
+      out << std::left << std::setw(20) << thread.thread << std::right << std::setw(10) << thread.acquisitions
+          << std::setw(14) << micros(thread.waitNs) << std::setw(14) << micros(thread.holdNs) << std::endl;
+    }
+    return out.str();
+  }
+
+  LIB_API std::string GILStats::toJSON() const
+  {
+    std::ostringstream out;
+    out << "{\"enabled\":" << (enabled ? "true" : "false") << ",\"wait\":";
+    writeJSON(out, wait);
+    out << ",\"hold\":";
+    writeJSON(out, hold);
+    out << ",\"sites\":[";
+    for (size_t i = 0; i < sites.size(); ++i)
+    {
+      const GILSiteStats &site = sites[i];
+      out << (i ? "," : "") << "{\"file\":" << jsonString(site.file) << ",\"line\":" << site.line
+          << ",\"kind\":\"" << toString(site.kind) << "\",\"wait\":";
+      writeJSON(out, site.wait);
+      out << ",\"hold\":";
+      writeJSON(out, site.hold);
+      out << "}";
+    }
+    out << "],\"threads\":[";
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+      const GILThreadStats &thread = threads[i];
+      out << (i ? "," : "") << "{\"thread\":" << jsonString(thread.thread) << ",\"acquisitions\":" << thread.acquisitions
+          << ",\"wait_ns\":" << thread.waitNs << ",\"hold_ns\":" << thread.holdNs << "}";
+    }
+    out << "]}";
+    return out.str();
+  }
+
+} // namespace
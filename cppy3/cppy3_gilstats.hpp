@@ -0,0 +1,80 @@
+/**
+ * GIL contention statistics
+ *
+ * With CPPY3_GIL_STATS=1 every GILLocker, ScopedGILLock and ScopedGILRelease
+ * records time spent waiting for GIL and time holding it, per call site and per thread.
+ * Without it the locks carry no instrumentation and the snapshot is empty.
+ */
+#pragma once
+
+#include "cppy3.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cppy3
+{
+
+  /** log2 histogram of durations: bucket 0 counts 0 ns, bucket i counts [2^(i-1), 2^i) ns */
+  struct LIB_API GILHistogram
+  {
+    static const size_t BUCKETS = 40;
+
+    uint64_t count = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    uint64_t buckets[BUCKETS] = {};
+
+    void add(uint64_t ns);
+    void merge(const GILHistogram &other);
+
+    /** @return upper bound in ns of the bucket holding @b q quantile, q in [0, 1] */
+    uint64_t quantile(double q) const;
+  };
+
+  struct GILSiteStats
+  {
+    std::string file;
+    int line;
+    GILLockKind kind;
+    /** one sample per acquisition */
+    GILHistogram wait;
+    /** empty for ScopedGILRelease, GIL is held beyond its scope */
+    GILHistogram hold;
+  };
+
+  struct GILThreadStats
+  {
+    std::string thread;
+    uint64_t acquisitions;
+    uint64_t waitNs;
+    uint64_t holdNs;
+  };
+
+  struct LIB_API GILStats
+  {
+    /** false if built without CPPY3_GIL_STATS */
+    bool enabled = false;
+    GILHistogram wait;
+    GILHistogram hold;
+    /** sorted by total wait time, longest first */
+    std::vector<GILSiteStats> sites;
+    /** live threads, exited ones are summed up in single "exited threads" entry */
+    std::vector<GILThreadStats> threads;
+
+    /** human readable tables */
+    std::string toText() const;
+
+    /** same data as JSON object, durations in ns */
+    std::string toJSON() const;
+  };
+
+  LIB_API const char *toString(GILLockKind kind);
+
+  /** @return statistics accumulated since start or last reset, safe to call from any thread */
+  LIB_API GILStats gilStats();
+
+  LIB_API void resetGILStats();
+
+} // namespace
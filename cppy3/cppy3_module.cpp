@@ -0,0 +1,301 @@
+#include "cppy3_module.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+
+namespace cppy3
+{
+
+  namespace
+  {
+    const char *const FUNCTION_CAPSULE = "cppy3.ExportedFunction";
+
+    /** arguments matched by keyword are collected here, larger signatures use heap */
+    const size_t INLINE_ARGUMENTS = 16;
+
+    PyObject *trampoline(PyObject *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
+    {
+      const auto *function = static_cast<std::shared_ptr<ExportedFunction> *>(PyCapsule_GetPointer(self, FUNCTION_CAPSULE));
+      assert(function);
+      return (*function)->invoke(args, nargs, kwnames);
+    }
+
+    void destroyFunction(PyObject *capsule)
+    {
+      delete static_cast<std::shared_ptr<ExportedFunction> *>(PyCapsule_GetPointer(capsule, FUNCTION_CAPSULE));
+    }
+
+    /** key of type object in interpreter dict, unique per class definition */
+    std::string typeKey(const ExportedClass *cls)
+    {
+      return "cppy3.Class." + std::to_string(reinterpret_cast<uintptr_t>(cls));
+    }
+  }
+
+  LIB_API std::string detail::describe(const std::exception_ptr &error)
+  {
+    try
+    {
+      std::rethrow_exception(error);
+    }
+    catch (const PythonException &e)
+    {
+      return WideToUTF8(e.info.type.empty() ? e.info.reason : e.info.type + L": " + e.info.reason);
+    }
+    catch (const std::exception &e)
+    {
+      return e.what();
+    }
+    catch (...)
+    {
+      return "unknown C++ exception";
+    }
+  }
+
+  LIB_API ExportedFunction::ExportedFunction(const std::string &name, size_t arity, const std::vector<std::string> &argNames,
+                                             const std::string &doc)
+      : _name(name), _arity(arity), _argNames(argNames)
+  {
+    if (argNames.size() > arity)
+    {
+      throw PythonException(name + "(): " + std::to_string(argNames.size()) + " argument names given for " + std::to_string(arity) + " arguments");
+    }
+
+    // __text_signature__ for inspect.signature(), expressible when every argument is named
+    if (argNames.size() == arity)
+    {
+      _doc = name + "(";
+      for (size_t i = 0; i < argNames.size(); ++i)
+      {
+        _doc += (i ? ", " : "") + argNames[i];
+      }
+      _doc += ")\n--\n\n";
+    }
+    _doc += doc;
+
+    _def.ml_name = _name.c_str();
+    _def.ml_meth = reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(&trampoline));
+    _def.ml_flags = METH_FASTCALL | METH_KEYWORDS;
+    _def.ml_doc = _doc.empty() ? NULL : _doc.c_str();
+  }
+
+  LIB_API ExportedFunction::~ExportedFunction()
+  {
+  }
+
+  LIB_API PyObject *ExportedFunction::invoke(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
+  {
+    const Py_ssize_t nkw = kwnames ? PyTuple_GET_SIZE(kwnames) : 0;
+    if (nkw == 0 && static_cast<size_t>(nargs) == _arity)
+    {
+      // positional call needs no reordering
+      return call(args);
+    }
+    if (static_cast<size_t>(nargs) > _arity)
+    {
+      PyErr_Format(PyExc_TypeError, "%s() takes %zu positional arguments but %zd were given", _name.c_str(), _arity, nargs);
+      return NULL;
+    }
+
+    PyObject *inlineArgs[INLINE_ARGUMENTS];
+    std::vector<PyObject *> heapArgs;
+    PyObject **ordered = inlineArgs;
+    if (_arity > INLINE_ARGUMENTS)
+    {
+      heapArgs.resize(_arity);
+      ordered = heapArgs.data();
+    }
+    std::fill(ordered, ordered + _arity, static_cast<PyObject *>(NULL));
+    std::copy(args, args + nargs, ordered);
+
+    for (Py_ssize_t k = 0; k < nkw; ++k)
+    {
+      Py_ssize_t size = 0;
+      const char *keyword = PyUnicode_AsUTF8AndSize(PyTuple_GET_ITEM(kwnames, k), &size);
+      if (keyword == NULL)
+      {
+        return NULL;
+      }
+      size_t i = 0;
+      while (i < _argNames.size() && (_argNames[i].size() != static_cast<size_t>(size) || std::memcmp(_argNames[i].data(), keyword, size) != 0))
+      {
+        ++i;
+      }
+      if (i == _argNames.size())
+      {
+        PyErr_Format(PyExc_TypeError, "%s() got an unexpected keyword argument '%s'", _name.c_str(), keyword);
+        return NULL;
+      }
+      if (ordered[i])
+      {
+        PyErr_Format(PyExc_TypeError, "%s() got multiple values for argument '%s'", _name.c_str(), keyword);
+        return NULL;
+      }
+      ordered[i] = args[nargs + k];
+    }
+
+    for (size_t i = 0; i < _arity; ++i)
+    {
+      if (ordered[i] == NULL)
+      {
+        if (i < _argNames.size())
+        {
+          PyErr_Format(PyExc_TypeError, "%s() missing required argument '%s'", _name.c_str(), _argNames[i].c_str());
+        }
+        else
+        {
+          PyErr_Format(PyExc_TypeError, "%s() missing required argument %zu", _name.c_str(), i + 1);
+        }
+        return NULL;
+      }
+    }
+    return call(ordered);
+  }
+
+  LIB_API PyObject *ExportedFunction::newFunction(const std::shared_ptr<ExportedFunction> &function, PyObject *module)
+  {
+    // capsule shares the function with builder, python function keeps capsule as its self
+    const Var self = Var::from(PyCapsule_New(new std::shared_ptr<ExportedFunction>(function), FUNCTION_CAPSULE, &destroyFunction));
+    if (self.null())
+    {
+      return NULL;
+    }
+    return PyCFunction_NewEx(&function->_def, self, module);
+  }
+
+  LIB_API void ExportedFunction::raise(const std::exception_ptr &error, size_t argument) const
+  {
+    const std::string message = detail::describe(error);
+    if (argument == NO_ARGUMENT)
+    {
+      PyErr_Format(PyExc_RuntimeError, "%s(): %s", _name.c_str(), message.c_str());
+    }
+    else if (argument < _argNames.size())
+    {
+      PyErr_Format(PyExc_TypeError, "%s() argument '%s': %s", _name.c_str(), _argNames[argument].c_str(), message.c_str());
+    }
+    else
+    {
+      PyErr_Format(PyExc_TypeError, "%s() argument %zu: %s", _name.c_str(), argument + 1, message.c_str());
+    }
+  }
+
+  LIB_API ExportedClass::~ExportedClass()
+  {
+  }
+
+  LIB_API void ExportedClass::registerType(PyObject *type) const
+  {
+    PyObject *dict = PyInterpreterState_GetDict(currentInterpreter());
+    if (dict == NULL || PyDict_SetItemString(dict, typeKey(this).c_str(), type) != 0)
+    {
+      rethrowPythonException();
+    }
+  }
+
+  LIB_API PyObject *ExportedClass::type() const
+  {
+    PyObject *dict = PyInterpreterState_GetDict(currentInterpreter());
+    const Var type = Var::from(dict ? dictItem(dict, typeKey(this).c_str()) : NULL);
+    // interpreter dict keeps it alive
+    return type.data();
+  }
+
+  struct Module::Definition
+  {
+    std::string name;
+    std::string doc;
+    PyModuleDef def;
+    std::vector<std::shared_ptr<ExportedFunction>> functions;
+    std::vector<std::shared_ptr<ExportedClass>> classes;
+  };
+
+  LIB_API Module::Module(const std::string &name, const std::string &doc) : _definition(std::make_shared<Definition>())
+  {
+    Definition &d = *_definition;
+    d.name = name;
+    d.doc = doc;
+    // single-phase initialization: import machinery of initializer passed to PythonVM requires module with def
+    d.def = {PyModuleDef_HEAD_INIT, d.name.c_str(), d.doc.empty() ? NULL : d.doc.c_str(), -1, NULL, NULL, NULL, NULL, NULL};
+  }
+
+  LIB_API const std::string &Module::name() const
+  {
+    return _definition->name;
+  }
+
+  LIB_API void Module::add(const std::shared_ptr<ExportedFunction> &function)
+  {
+    _definition->functions.push_back(function);
+  }
+
+  LIB_API void Module::addClass(const std::shared_ptr<ExportedClass> &cls)
+  {
+    _definition->classes.push_back(cls);
+  }
+
+  LIB_API PyObject *Module::create() const
+  {
+    // serves as PyInit_* body called by import machinery, so no C++ exception may escape
+    try
+    {
+      {
+        // python keeps PyModuleDef of single-phase modules until finalization (extension cache, module_dealloc),
+        // so definition must outlive builder, which is often a temporary
+        static std::mutex mutex;
+        static std::vector<std::shared_ptr<Definition>> created;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::find(created.begin(), created.end(), _definition) == created.end())
+        {
+          created.push_back(_definition);
+        }
+      }
+
+      Var module = Var::from(PyModule_Create(&_definition->def));
+      if (module.null())
+      {
+        return NULL;
+      }
+
+      const Var moduleName = Var::from(convert(std::string_view(name())));
+      for (const auto &function : _definition->functions)
+      {
+        const Var f = Var::from(ExportedFunction::newFunction(function, moduleName));
+        if (f.null() || PyObject_SetAttrString(module, function->name().c_str(), f) != 0)
+        {
+          return NULL;
+        }
+      }
+      for (const auto &cls : _definition->classes)
+      {
+        // type refers to names and closures of class definition, it lives as long as module definition
+        const Var type = Var::from(cls->createType(module));
+        if (type.null() || PyObject_SetAttrString(module, cls->name().c_str(), type) != 0)
+        {
+          return NULL;
+        }
+        cls->registerType(type);
+      }
+      return module.release();
+    }
+    catch (...)
+    {
+      PyErr_Format(PyExc_ImportError, "module %s: %s", name().c_str(), detail::describe(std::current_exception()).c_str());
+      return NULL;
+    }
+  }
+
+  LIB_API Var Module::install() const
+  {
+    GILLocker lock;
+    Var module = Var::from(create());
+    if (module.null() || PyDict_SetItemString(PyImport_GetModuleDict(), name().c_str(), module) != 0)
+    {
+      rethrowPythonException();
+    }
+    return module;
+  }
+
+} // namespace
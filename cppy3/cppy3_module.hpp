@@ -0,0 +1,369 @@
+/**
+ * Export C++ functions and lambdas to python
+ *
+ * Module builder wraps callables into METH_FASTCALL | METH_KEYWORDS functions,
+ * arguments are converted with extract() and result with convert() by code generated
+ * for the callable signature, no format string is parsed per call.
+ */
+#pragma once
+
+#include "cppy3.hpp"
+
+#include <exception>
+#include <limits>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cppy3
+{
+
+  namespace detail
+  {
+
+    template <typename F>
+    struct CallableTraits : CallableTraits<decltype(&F::operator())>
+    {
+    };
+
+    template <typename R, typename... Args>
+    struct CallableTraits<R (*)(Args...)>
+    {
+      typedef R Result;
+      typedef std::tuple<typename std::decay<Args>::type...> Arguments;
+      static const size_t arity = sizeof...(Args);
+    };
+
+    template <typename R, typename... Args>
+    struct CallableTraits<R (*)(Args...) noexcept> : CallableTraits<R (*)(Args...)>
+    {
+    };
+
+    template <typename C, typename R, typename... Args>
+    struct CallableTraits<R (C::*)(Args...)> : CallableTraits<R (*)(Args...)>
+    {
+    };
+
+    template <typename C, typename R, typename... Args>
+    struct CallableTraits<R (C::*)(Args...) const> : CallableTraits<R (*)(Args...)>
+    {
+    };
+
+    template <typename C, typename R, typename... Args>
+    struct CallableTraits<R (C::*)(Args...) noexcept> : CallableTraits<R (*)(Args...)>
+    {
+    };
+
+    template <typename C, typename R, typename... Args>
+    struct CallableTraits<R (C::*)(Args...) const noexcept> : CallableTraits<R (*)(Args...)>
+    {
+    };
+
+    /** python argument to C++ value, throws PythonException if it does not fit */
+    template <typename T>
+    T fromPython(PyObject *o)
+    {
+      if constexpr (std::is_same<T, Var>::value)
+      {
+        return Var(o);
+      }
+      else if constexpr (std::is_same<T, PyObject *>::value)
+      {
+        return o;
+      }
+      else if constexpr (std::is_same<T, bool>::value)
+      {
+        const int r = PyObject_IsTrue(o);
+        if (r < 0)
+        {
+          rethrowPythonException();
+        }
+        return r != 0;
+      }
+      else if constexpr (std::is_floating_point<T>::value)
+      {
+        // accepts int like python float parameters do
+        const double value = PyFloat_AsDouble(o);
+        if (value == -1.0 && PyErr_Occurred())
+        {
+          rethrowPythonException();
+        }
+        return static_cast<T>(value);
+      }
+      else if constexpr (std::is_integral<T>::value && std::is_unsigned<T>::value)
+      {
+        // negative ints raise OverflowError too
+        const unsigned long long value = PyLong_AsUnsignedLongLong(o);
+        if (value == static_cast<unsigned long long>(-1) && PyErr_Occurred())
+        {
+          rethrowPythonException();
+        }
+        if (value > std::numeric_limits<T>::max())
+        {
+          PyErr_Format(PyExc_OverflowError, "int too big to convert to %zu byte unsigned integer", sizeof(T));
+          rethrowPythonException();
+        }
+        return static_cast<T>(value);
+      }
+      else if constexpr (std::is_integral<T>::value && !std::is_same<T, int>::value && !std::is_same<T, long>::value)
+      {
+        long long value = 0;
+        extract(o, value);
+        if (value < std::numeric_limits<T>::min() || value > std::numeric_limits<T>::max())
+        {
+          PyErr_Format(PyExc_OverflowError, "int out of range of %zu byte integer", sizeof(T));
+          rethrowPythonException();
+        }
+        return static_cast<T>(value);
+      }
+      else
+      {
+        T value;
+        extract(o, value);
+        return value;
+      }
+    }
+
+    /** C++ result to new reference, returned PyObject* is taken as new reference too */
+    template <typename T>
+    PyObject *toPython(const T &value)
+    {
+      if constexpr (std::is_same<T, Var>::value)
+      {
+        PyObject *o = value.data() ? value.data() : Py_None;
+        Py_INCREF(o);
+        return o;
+      }
+      else if constexpr (std::is_same<T, PyObject *>::value)
+      {
+        return value;
+      }
+      else if constexpr (std::is_same<T, bool>::value)
+      {
+        return PyBool_FromLong(value);
+      }
+      else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value && !std::is_same<T, int>::value && !std::is_same<T, long>::value)
+      {
+        return PyLong_FromLongLong(value);
+      }
+      else if constexpr (std::is_integral<T>::value && std::is_unsigned<T>::value)
+      {
+        return PyLong_FromUnsignedLongLong(value);
+      }
+      else if constexpr (std::is_same<T, float>::value)
+      {
+        return PyFloat_FromDouble(value);
+      }
+      else if constexpr (std::is_same<T, std::string>::value)
+      {
+        return convert(std::string_view(value));
+      }
+      else
+      {
+        return convert(value);
+      }
+    }
+
+    /** @return message of C++ or python exception */
+    LIB_API std::string describe(const std::exception_ptr &error);
+
+  } // namespace detail
+
+  /**
+   * Type-erased C++ function exported to python.
+   * Keyword arguments are matched to positions before call(), which gets exactly arity() arguments
+   */
+  class LIB_API ExportedFunction
+  {
+  public:
+    ExportedFunction(const std::string &name, size_t arity, const std::vector<std::string> &argNames, const std::string &doc);
+    virtual ~ExportedFunction();
+
+    ExportedFunction(const ExportedFunction &) = delete;
+    ExportedFunction &operator=(const ExportedFunction &) = delete;
+
+    /** @return new reference to result or NULL with python error set */
+    virtual PyObject *call(PyObject *const *args) = 0;
+
+    /** METH_FASTCALL | METH_KEYWORDS entry point */
+    PyObject *invoke(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames);
+
+    const std::string &name() const { return _name; }
+    size_t arity() const { return _arity; }
+
+    static const size_t NO_ARGUMENT = static_cast<size_t>(-1);
+
+    /** set python error for exception thrown by C++ code, converting @b argument or by the function itself */
+    void raise(const std::exception_ptr &error, size_t argument) const;
+
+    /**
+     * @return new reference to python function calling @b function
+     * @param module - name of module the function belongs to
+     */
+    static PyObject *newFunction(const std::shared_ptr<ExportedFunction> &function, PyObject *module);
+
+  private:
+    std::string _name;
+    size_t _arity;
+    std::vector<std::string> _argNames;
+    std::string _doc;
+    PyMethodDef _def;
+  };
+
+  template <typename F>
+  class ExportedCallable : public ExportedFunction
+  {
+  public:
+    typedef detail::CallableTraits<typename std::decay<F>::type> Traits;
+
+    ExportedCallable(const std::string &name, F function, const std::vector<std::string> &argNames, const std::string &doc)
+        : ExportedFunction(name, Traits::arity, argNames, doc), _function(std::move(function))
+    {
+    }
+
+    PyObject *call(PyObject *const *args) override
+    {
+      return call(args, std::make_index_sequence<Traits::arity>());
+    }
+
+  private:
+    /** failure converting argument @b index */
+    struct ArgumentError
+    {
+      size_t index;
+      std::exception_ptr error;
+    };
+
+    template <size_t I>
+    static typename std::tuple_element<I, typename Traits::Arguments>::type argument(PyObject *const *args)
+    {
+      try
+      {
+        return detail::fromPython<typename std::tuple_element<I, typename Traits::Arguments>::type>(args[I]);
+      }
+      catch (...)
+      {
+        throw ArgumentError{I, std::current_exception()};
+      }
+    }
+
+    template <size_t... I>
+    PyObject *call(PyObject *const *args, std::index_sequence<I...>)
+    {
+      try
+      {
+        typename Traits::Arguments values{argument<I>(args)...};
+        (void)args;
+        if constexpr (std::is_void<typename Traits::Result>::value)
+        {
+          _function(std::get<I>(values)...);
+          Py_RETURN_NONE;
+        }
+        else
+        {
+          return detail::toPython<typename std::decay<typename Traits::Result>::type>(_function(std::get<I>(values)...));
+        }
+      }
+      catch (const ArgumentError &e)
+      {
+        raise(e.error, e.index);
+        return NULL;
+      }
+      catch (...)
+      {
+        raise(std::current_exception(), NO_ARGUMENT);
+        return NULL;
+      }
+    }
+
+    F _function;
+  };
+
+  /**
+   * Type-erased C++ class exported to python, @see Class in cppy3_class.hpp
+   * Type object is created per interpreter and found again by registerType() / type()
+   */
+  class LIB_API ExportedClass
+  {
+  public:
+    virtual ~ExportedClass();
+
+    virtual const std::string &name() const = 0;
+
+    /** @return new reference to heap type for @b module */
+    virtual PyObject *createType(PyObject *module) = 0;
+
+    /** remember @b type as this class in the current interpreter */
+    void registerType(PyObject *type) const;
+
+    /** @return borrowed type of this class in the current interpreter or NULL if it is not exported there */
+    PyObject *type() const;
+  };
+
+  template <typename T>
+  class Class;
+
+  /**
+   * Python module built of C++ callables and classes
+   *
+   *   cppy3::Module("emb")
+   *     .def("hello", [](const std::string &name) { ... }, {"name"}, "Say hello.")
+   *     .type(orderClass)
+   *     .install();
+   *
+   * Arguments and result may be of any type supported by extract() / convert(), bool, Var or PyObject*;
+   * floating point arguments accept int too.
+   * Named arguments can be passed by keyword, the rest are positional-only.
+   * Builder can create the module any number of times, e.g. for each sub-interpreter;
+   * exported callables are shared and must be thread safe then. Copies of builder share definition.
+   */
+  class LIB_API Module
+  {
+  public:
+    explicit Module(const std::string &name, const std::string &doc = std::string());
+
+    /**
+     * Export @b function as @b name
+     * @param argNames - names of leading arguments, allow passing them by keyword
+     */
+    template <typename F>
+    Module &def(const std::string &name, F function, const std::vector<std::string> &argNames = std::vector<std::string>(),
+                const std::string &doc = std::string())
+    {
+      add(std::make_shared<ExportedCallable<F>>(name, std::move(function), argNames, doc));
+      return *this;
+    }
+
+    /** Export C++ class, @see cppy3_class.hpp */
+    template <typename T>
+    Module &type(const Class<T> &cls)
+    {
+      addClass(cls.definition());
+      return *this;
+    }
+
+    /**
+     * Create module object, GIL required.
+     * Can be returned from initializer passed to PythonVM, does not throw
+     * @return new reference or NULL with python error set
+     */
+    PyObject *create() const;
+
+    /** create module and put it in sys.modules, so python can import it */
+    Var install() const;
+
+    const std::string &name() const;
+
+  private:
+    void add(const std::shared_ptr<ExportedFunction> &function);
+    void addClass(const std::shared_ptr<ExportedClass> &cls);
+
+    /** shared by copies, kept alive by create() as PyModuleDef must outlive modules created from it */
+    struct Definition;
+    std::shared_ptr<Definition> _definition;
+  };
+
+} // namespace
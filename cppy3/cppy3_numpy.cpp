@@ -1,12 +1,289 @@
 
 #include "cppy3.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #define INCLUDED_FROM_CPPY3_NUMPY_CPP
 #include "cppy3_numpy.hpp"
 #undef INCLUDED_FROM_CPPY3_NUMPY_CPP
 
 namespace cppy3
 {
+  namespace
+  {
+    std::atomic<unsigned> copyThreads(1);
+    std::atomic<size_t> copyBytesPerThread(4 << 20);
+
+    const char *const OWNER_CAPSULE = "cppy3.NDArray.owner";
+
+    void destroyOwner(PyObject *capsule)
+    {
+      delete static_cast<std::shared_ptr<void> *>(PyCapsule_GetPointer(capsule, OWNER_CAPSULE));
+    }
+
+    /** DLPack capsule names, consumer renames capsule it takes tensor from */
+    const char *const DLPACK_CAPSULE = "dltensor";
+    const char *const USED_DLPACK_CAPSULE = "used_dltensor";
+
+    void destroyDLPackCapsule(PyObject *capsule)
+    {
+      if (PyCapsule_IsValid(capsule, DLPACK_CAPSULE))
+      {
+        DLManagedTensor *tensor = static_cast<DLManagedTensor *>(PyCapsule_GetPointer(capsule, DLPACK_CAPSULE));
+        if (tensor->deleter)
+        {
+          tensor->deleter(tensor);
+        }
+      }
+    }
+
+    /** manager context of tensor exported from ndarray */
+    struct DLPackExport
+    {
+      DLManagedTensor tensor;
+      std::vector<int64_t> shape;
+      std::vector<int64_t> strides;
+      PyArrayObject *array;
+      /** lifetime of interpreter array belongs to */
+      std::shared_ptr<std::atomic<bool>> interpreter;
+    };
+
+    void deleteDLPackExport(DLManagedTensor *tensor)
+    {
+      DLPackExport *exported = static_cast<DLPackExport *>(tensor->manager_ctx);
+      if (*exported->interpreter && Py_IsInitialized())
+      {
+        GILLocker lock;
+        Py_DECREF(exported->array);
+      }
+      else if (*exported->interpreter && attachedThreadState())
+      {
+        // capsule dropped while finalizing, finalizing thread holds GIL
+        Py_DECREF(exported->array);
+      }
+      // else tensor outlived interpreter, array is gone with it, nothing left to release
+      delete exported;
+    }
+
+    /** side of square tile for transposing copies, in elements */
+    const npy_intp TILE = 64;
+
+    /** copy layout with unit dimensions dropped and dense neighbour dimensions merged */
+    struct CopyLayout
+    {
+      int ndim;
+      npy_intp shape[NPY_MAXDIMS];
+      npy_intp dst[NPY_MAXDIMS];
+      npy_intp src[NPY_MAXDIMS];
+    };
+
+    CopyLayout coalesce(const npy_intp *dstStrides, const npy_intp *srcStrides, const npy_intp *shape, int ndim, size_t itemsize)
+    {
+      CopyLayout l;
+      l.ndim = 0;
+      for (int d = 0; d < ndim; ++d)
+      {
+        if (shape[d] == 1)
+        {
+          continue;
+        }
+        const int last = l.ndim - 1;
+        if (last >= 0 && l.dst[last] == dstStrides[d] * shape[d] && l.src[last] == srcStrides[d] * shape[d])
+        {
+          l.shape[last] *= shape[d];
+          l.dst[last] = dstStrides[d];
+          l.src[last] = srcStrides[d];
+        }
+        else
+        {
+          l.shape[l.ndim] = shape[d];
+          l.dst[l.ndim] = dstStrides[d];
+          l.src[l.ndim] = srcStrides[d];
+          ++l.ndim;
+        }
+      }
+      if (l.ndim == 0)
+      {
+        // scalar
+        l.ndim = 1;
+        l.shape[0] = 1;
+        l.dst[0] = l.src[0] = itemsize;
+      }
+      return l;
+    }
+
+    template <typename T>
+    void copyElements(char *dst, npy_intp dstStride, const char *src, npy_intp srcStride, npy_intp n)
+    {
+      // fixed size memcpy compiles to plain load/store, loop vectorizes where strides allow
+      for (npy_intp i = 0; i < n; ++i)
+      {
+        T value;
+        std::memcpy(&value, src + i * srcStride, sizeof(T));
+        std::memcpy(dst + i * dstStride, &value, sizeof(T));
+      }
+    }
+
+    void copyRow(char *dst, npy_intp dstStride, const char *src, npy_intp srcStride, npy_intp n, size_t itemsize)
+    {
+      const npy_intp size = static_cast<npy_intp>(itemsize);
+      if (dstStride == size && srcStride == size)
+      {
+        std::memcpy(dst, src, n * itemsize);
+        return;
+      }
+      switch (itemsize)
+      {
+      case 1:
+        copyElements<uint8_t>(dst, dstStride, src, srcStride, n);
+        break;
+      case 2:
+        copyElements<uint16_t>(dst, dstStride, src, srcStride, n);
+        break;
+      case 4:
+        copyElements<uint32_t>(dst, dstStride, src, srcStride, n);
+        break;
+      case 8:
+        copyElements<uint64_t>(dst, dstStride, src, srcStride, n);
+        break;
+      default:
+        for (npy_intp i = 0; i < n; ++i)
+        {
+          std::memcpy(dst + i * dstStride, src + i * srcStride, itemsize);
+        }
+      }
+    }
+
+    /** copy of two innermost dimensions, in tiles when one side walks them transposed */
+    void copyPlane(char *dst, const char *src, const CopyLayout &l, int d, size_t itemsize)
+    {
+      const npy_intp size = static_cast<npy_intp>(itemsize);
+      const npy_intp n0 = l.shape[d], n1 = l.shape[d + 1];
+      const bool transposing = (l.src[d + 1] != size && l.src[d] == size) || (l.dst[d + 1] != size && l.dst[d] == size);
+      if (!transposing)
+      {
+        for (npy_intp i = 0; i < n0; ++i)
+        {
+          copyRow(dst + i * l.dst[d], l.dst[d + 1], src + i * l.src[d], l.src[d + 1], n1, itemsize);
+        }
+        return;
+      }
+      for (npy_intp i0 = 0; i0 < n0; i0 += TILE)
+      {
+        const npy_intp i1 = std::min(n0, i0 + TILE);
+        for (npy_intp j0 = 0; j0 < n1; j0 += TILE)
+        {
+          const npy_intp count = std::min(n1 - j0, TILE);
+          for (npy_intp i = i0; i < i1; ++i)
+          {
+            copyRow(dst + i * l.dst[d] + j0 * l.dst[d + 1], l.dst[d + 1], src + i * l.src[d] + j0 * l.src[d + 1], l.src[d + 1], count,
+                    itemsize);
+          }
+        }
+      }
+    }
+
+    void copyDimension(char *dst, const char *src, const CopyLayout &l, int d, size_t itemsize)
+    {
+      if (d == l.ndim - 1)
+      {
+        copyRow(dst, l.dst[d], src, l.src[d], l.shape[d], itemsize);
+      }
+      else if (d == l.ndim - 2)
+      {
+        copyPlane(dst, src, l, d, itemsize);
+      }
+      else
+      {
+        for (npy_intp i = 0; i < l.shape[d]; ++i)
+        {
+          copyDimension(dst + i * l.dst[d], src + i * l.src[d], l, d + 1, itemsize);
+        }
+      }
+    }
+
+    /** copy of rows [begin, end) of outermost dimension */
+    void copyRange(char *dst, const char *src, CopyLayout l, npy_intp begin, npy_intp end, size_t itemsize)
+    {
+      l.shape[0] = end - begin;
+      copyDimension(dst + begin * l.dst[0], src + begin * l.src[0], l, 0, itemsize);
+    }
+  }
+
+  namespace
+  {
+    std::mutex poolMutex;
+    std::shared_ptr<BufferPool> arrayPool;
+  }
+
+  void setNDArrayPool(const std::shared_ptr<BufferPool> &pool)
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    arrayPool = pool;
+  }
+
+  std::shared_ptr<BufferPool> ndarrayPool()
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return arrayPool;
+  }
+
+  void setCopyThreads(unsigned threads, size_t minBytesPerThread)
+  {
+    copyThreads = std::max(threads, 1U);
+    copyBytesPerThread = std::max<size_t>(minBytesPerThread, 1);
+  }
+
+  namespace detail
+  {
+    void copyStrided(void *dst, const npy_intp *dstStrides, const void *src, const npy_intp *srcStrides, const npy_intp *shape,
+                     int ndim, size_t itemsize)
+    {
+      npy_intp count = 1;
+      for (int d = 0; d < ndim; ++d)
+      {
+        count *= shape[d];
+      }
+      if (count == 0)
+      {
+        return;
+      }
+
+      const CopyLayout l = coalesce(dstStrides, srcStrides, shape, ndim, itemsize);
+      char *to = static_cast<char *>(dst);
+      const char *from = static_cast<const char *>(src);
+      const size_t threads = std::min<size_t>({copyThreads.load(), count * itemsize / copyBytesPerThread.load(),
+                                               static_cast<size_t>(l.shape[0])});
+      if (threads < 2)
+      {
+        copyRange(to, from, l, 0, l.shape[0], itemsize);
+        return;
+      }
+
+      // copy touches no python objects
+      ScopedGILRelease release;
+      std::vector<std::thread> workers;
+      const npy_intp chunk = (l.shape[0] + threads - 1) / threads;
+      for (size_t t = 1; t < threads; ++t)
+      {
+        const npy_intp begin = std::min<npy_intp>(t * chunk, l.shape[0]);
+        const npy_intp end = std::min<npy_intp>(begin + chunk, l.shape[0]);
+        workers.emplace_back(&copyRange, to, from, l, begin, end, itemsize);
+      }
+      copyRange(to, from, l, 0, std::min<npy_intp>(chunk, l.shape[0]), itemsize);
+      for (std::thread &worker : workers)
+      {
+        worker.join();
+      }
+    }
+  }
   // workaround numpy & python3 https://github.com/boostorg/python/issues/214
   // return NULL to avoid UB https://wanzenbug.xyz/boost-numpy/
   static void *wrap_import_array() { import_array(); return NULL; }
@@ -23,6 +300,20 @@ namespace cppy3
     }
   }
 
+  PyObject *dlpackCapsule(DLManagedTensor *tensor)
+  {
+    PyObject *capsule = PyCapsule_New(tensor, DLPACK_CAPSULE, &destroyDLPackCapsule);
+    if (capsule == NULL)
+    {
+      if (tensor && tensor->deleter)
+      {
+        tensor->deleter(tensor);
+      }
+      rethrowPythonException();
+    }
+    return capsule;
+  }
+
   NPY_TYPES toNumpyDType(double)
   {
     return NPY_DOUBLE;
@@ -33,4 +324,148 @@ namespace cppy3
     return NPY_INT;
   }
 
+  namespace detail
+  {
+    PyObject *ownerCapsule(const std::shared_ptr<void> &owner)
+    {
+      std::shared_ptr<void> *shared = new std::shared_ptr<void>(owner);
+      PyObject *capsule = PyCapsule_New(shared, OWNER_CAPSULE, &destroyOwner);
+      if (capsule == NULL)
+      {
+        delete shared;
+        rethrowPythonException();
+      }
+      return capsule;
+    }
+
+    std::shared_ptr<void> dlpackOwner(DLManagedTensor *tensor)
+    {
+      if (tensor == NULL)
+      {
+        throw PythonException("NULL DLPack tensor");
+      }
+      return std::shared_ptr<void>(tensor, [](void *p) {
+        DLManagedTensor *t = static_cast<DLManagedTensor *>(p);
+        if (t->deleter)
+        {
+          t->deleter(t);
+        }
+      });
+    }
+
+    DLManagedTensor *dlpackImport(PyObject *o)
+    {
+      const Var capsule = PyCapsule_CheckExact(o) ? Var(o) : Var::from(PyObject_CallMethod(o, "__dlpack__", NULL));
+      if (capsule.null())
+      {
+        rethrowPythonException();
+      }
+      DLManagedTensor *tensor = static_cast<DLManagedTensor *>(PyCapsule_GetPointer(capsule, DLPACK_CAPSULE));
+      if (tensor == NULL || PyCapsule_SetName(capsule, USED_DLPACK_CAPSULE) != 0)
+      {
+        rethrowPythonException();
+      }
+      return tensor;
+    }
+
+    std::vector<npy_intp> dlpackStrides(const DLTensor &tensor, DLDataType dtype, size_t itemsize)
+    {
+      if (tensor.device.device_type != kDLCPU && tensor.device.device_type != kDLCUDAHost)
+      {
+        throw PythonException("DLPack tensor on device " + std::to_string(tensor.device.device_type) + " is not in CPU memory");
+      }
+      if (tensor.dtype.code != dtype.code || tensor.dtype.bits != dtype.bits || tensor.dtype.lanes != dtype.lanes)
+      {
+        throw PythonException("DLPack tensor of type code " + std::to_string(tensor.dtype.code) + ", " + std::to_string(tensor.dtype.bits) +
+                              " bits does not hold elements of type code " + std::to_string(dtype.code) + ", " + std::to_string(dtype.bits) + " bits");
+      }
+      if (tensor.ndim < 0 || tensor.ndim > NPY_MAXDIMS)
+      {
+        throw PythonException("DLPack tensor of " + std::to_string(tensor.ndim) + " dimensions");
+      }
+      std::vector<npy_intp> strides;
+      if (tensor.strides)
+      {
+        for (int32_t d = 0; d < tensor.ndim; ++d)
+        {
+          strides.push_back(static_cast<npy_intp>(tensor.strides[d] * itemsize));
+        }
+      }
+      return strides;
+    }
+
+    DLManagedTensor *dlpackExport(PyArrayObject *array, DLDataType dtype)
+    {
+      std::unique_ptr<DLPackExport> exported(new DLPackExport());
+      const int ndim = PyArray_NDIM(array);
+      const npy_intp itemsize = PyArray_ITEMSIZE(array);
+      exported->shape.assign(PyArray_DIMS(array), PyArray_DIMS(array) + ndim);
+      for (int d = 0; d < ndim; ++d)
+      {
+        // DLPack strides count elements
+        if (PyArray_STRIDE(array, d) % itemsize != 0)
+        {
+          throw PythonException("ndarray strides are not multiples of element size");
+        }
+        exported->strides.push_back(PyArray_STRIDE(array, d) / itemsize);
+      }
+
+      DLTensor &t = exported->tensor.dl_tensor;
+      t.data = PyArray_DATA(array);
+      t.device = DLDevice{kDLCPU, 0};
+      t.ndim = ndim;
+      t.dtype = dtype;
+      t.shape = exported->shape.data();
+      t.strides = exported->strides.data();
+      t.byte_offset = 0;
+      exported->tensor.manager_ctx = exported.get();
+      exported->tensor.deleter = &deleteDLPackExport;
+      exported->interpreter = interpreterAlive();
+      Py_INCREF(array);
+      exported->array = array;
+      return &exported.release()->tensor;
+    }
+
+    PyArray_Descr *recordDescr(const std::vector<std::string> &names, const std::vector<Var> &formats,
+                               const std::vector<size_t> &offsets, size_t itemsize)
+    {
+      assert(names.size() == formats.size() && names.size() == offsets.size());
+      const Var nameList = Var::from(PyList_New(names.size()));
+      const Var formatList = Var::from(PyList_New(names.size()));
+      const Var offsetList = Var::from(PyList_New(names.size()));
+      for (size_t i = 0; i < names.size(); ++i)
+      {
+        PyList_SET_ITEM(nameList.data(), i, convert(std::string_view(names[i])));
+        PyList_SET_ITEM(formatList.data(), i, Var(formats[i]).release());
+        PyList_SET_ITEM(offsetList.data(), i, PyLong_FromSize_t(offsets[i]));
+      }
+      // numpy dict form: {'names': [...], 'formats': [...], 'offsets': [...], 'itemsize': n}
+      const Var spec = Var::from(PyDict_New());
+      const Var size = Var::from(PyLong_FromSize_t(itemsize));
+      PyDict_SetItemString(spec, "names", nameList);
+      PyDict_SetItemString(spec, "formats", formatList);
+      PyDict_SetItemString(spec, "offsets", offsetList);
+      PyDict_SetItemString(spec, "itemsize", size);
+
+      PyArray_Descr *descr = NULL;
+      if (!PyArray_DescrConverter(spec, &descr))
+      {
+        rethrowPythonException();
+      }
+      return descr;
+    }
+
+    PyArray_Descr *subarrayDescr(const Var &base, size_t n)
+    {
+      const Var count = Var::from(PyLong_FromSize_t(n));
+      const Var spec = Var::from(PyTuple_Pack(2, base.data(), count.data()));
+      PyArray_Descr *descr = NULL;
+      if (!PyArray_DescrConverter(spec, &descr))
+      {
+        rethrowPythonException();
+      }
+      return descr;
+    }
+  }
+
 }
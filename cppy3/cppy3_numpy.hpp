@@ -27,6 +27,16 @@
 #include <numpy/arrayobject.h>
 
 #include <cassert>
+#include <complex>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "cppy3.hpp"
+#include "cppy3_dlpack.hpp"
+#include "cppy3_pool.hpp"
 
 // fill with zeros by default new NDArray objects
 #define SLOWER_AND_CLEARNER false
@@ -40,7 +50,263 @@ namespace cppy3
   NPY_TYPES toNumpyDType(int);
 
   /**
-   * Simple wrapper for numpy.ndarray
+   * Storage of IEEE 754 half precision value, element of numpy.float16 arrays; no arithmetic
+   */
+  struct float16
+  {
+    uint16_t bits;
+  };
+
+  /**
+   * Compile-time numpy dtype of C++ element type.
+   * Specializations provide descr() returning new reference to descriptor, scalars also typenum.
+   * Structs are mapped by deriving specialization from RecordDType
+   */
+  template <typename T, typename Enable = void>
+  struct DType
+  {
+    static_assert(sizeof(T) == 0, "no numpy dtype for this type, specialize cppy3::DType");
+  };
+
+  template <int TypeNum>
+  struct ScalarDType
+  {
+    static const int typenum = TypeNum;
+
+    static PyArray_Descr *descr()
+    {
+      return PyArray_DescrFromType(TypeNum);
+    }
+  };
+
+  namespace detail
+  {
+    template <size_t Size, bool Signed>
+    struct IntegerTypeNum;
+    template <> struct IntegerTypeNum<1, true> { static const int value = NPY_INT8; };
+    template <> struct IntegerTypeNum<2, true> { static const int value = NPY_INT16; };
+    template <> struct IntegerTypeNum<4, true> { static const int value = NPY_INT32; };
+    template <> struct IntegerTypeNum<8, true> { static const int value = NPY_INT64; };
+    template <> struct IntegerTypeNum<1, false> { static const int value = NPY_UINT8; };
+    template <> struct IntegerTypeNum<2, false> { static const int value = NPY_UINT16; };
+    template <> struct IntegerTypeNum<4, false> { static const int value = NPY_UINT32; };
+    template <> struct IntegerTypeNum<8, false> { static const int value = NPY_UINT64; };
+
+    /** @return new reference to descriptor of struct with given fields */
+    PyArray_Descr *recordDescr(const std::vector<std::string> &names, const std::vector<Var> &formats,
+                               const std::vector<size_t> &offsets, size_t itemsize);
+
+    /** @return new reference to descriptor of fixed size array of @b base elements */
+    PyArray_Descr *subarrayDescr(const Var &base, size_t n);
+
+    /** @return new reference to capsule sharing @b owner, for ndarray base */
+    PyObject *ownerCapsule(const std::shared_ptr<void> &owner);
+
+    /** @return owner calling deleter of @b tensor when released */
+    std::shared_ptr<void> dlpackOwner(DLManagedTensor *tensor);
+
+    /**
+     * Take tensor out of "dltensor" capsule or object implementing __dlpack__(), capsule is marked used
+     * @throws PythonException if object provides no DLPack tensor
+     */
+    DLManagedTensor *dlpackImport(PyObject *o);
+
+    /**
+     * @return strides of CPU @b tensor of @b dtype elements in bytes, empty for C-contiguous
+     * @throws PythonException if tensor is on other device or of other data type
+     */
+    std::vector<npy_intp> dlpackStrides(const DLTensor &tensor, DLDataType dtype, size_t itemsize);
+
+    /** @return tensor referring to data of @b array, keeps array alive until deleter is called */
+    DLManagedTensor *dlpackExport(PyArrayObject *array, DLDataType dtype);
+
+    /**
+     * Copy N-d block of @b itemsize elements between layouts given by byte strides.
+     * Dimensions dense in both are merged into bulk memcpy, transposing copies go in cache tiles,
+     * large copies are split among threads of setCopyThreads() with GIL released
+     */
+    void copyStrided(void *dst, const npy_intp *dstStrides, const void *src, const npy_intp *srcStrides, const npy_intp *shape,
+                     int ndim, size_t itemsize);
+  }
+
+  /**
+   * Make NDArray::create() take memory from @b pool, NULL restores numpy allocator
+   */
+  void setNDArrayPool(const std::shared_ptr<BufferPool> &pool);
+
+  /** @return pool of setNDArrayPool() */
+  std::shared_ptr<BufferPool> ndarrayPool();
+
+  /**
+   * @return new reference to "dltensor" capsule taking @b tensor, for python consumers such as torch.from_dlpack().
+   * Deleter is called when capsule is dropped unconsumed
+   */
+  PyObject *dlpackCapsule(DLManagedTensor *tensor);
+
+  /**
+   * Split NDArray copies larger than @b minBytesPerThread * 2 among up to @b threads threads, 1 disables
+   */
+  void setCopyThreads(unsigned threads, size_t minBytesPerThread = 4 << 20);
+
+  // integers of any width and signedness, e.g. int64_t is long or long long depending on platform
+  template <typename T>
+  struct DType<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+      : ScalarDType<detail::IntegerTypeNum<sizeof(T), std::is_signed<T>::value>::value>
+  {
+  };
+
+  static_assert(sizeof(bool) == 1, "numpy.bool_ is one byte");
+  template <> struct DType<bool> : ScalarDType<NPY_BOOL> {};
+  template <> struct DType<float16> : ScalarDType<NPY_FLOAT16> {};
+  template <> struct DType<float> : ScalarDType<NPY_FLOAT32> {};
+  template <> struct DType<double> : ScalarDType<NPY_FLOAT64> {};
+  template <> struct DType<std::complex<float>> : ScalarDType<NPY_COMPLEX64> {};
+  template <> struct DType<std::complex<double>> : ScalarDType<NPY_COMPLEX128> {};
+
+  /** fixed size array field, e.g. float levels[5] */
+  template <typename T, size_t N>
+  struct DType<T[N]>
+  {
+    static PyArray_Descr *descr()
+    {
+      return detail::subarrayDescr(Var::from(reinterpret_cast<PyObject *>(DType<T>::descr())), N);
+    }
+  };
+
+  /**
+   * Structured dtype of C++ struct, layout is taken from the struct itself:
+   *
+   *   struct Quote { int64_t time; float bid; float ask; };
+   *
+   *   template <>
+   *   struct cppy3::DType<Quote> : cppy3::RecordDType<Quote>
+   *   {
+   *     static Fields fields() { return {field("time", &Quote::time), field("bid", &Quote::bid), field("ask", &Quote::ask)}; }
+   *   };
+   *
+   * Fields may be any types with DType, records included. Unlisted members are padding for numpy.
+   */
+  template <typename T>
+  struct RecordDType
+  {
+    struct Field
+    {
+      std::string name;
+      PyArray_Descr *(*descr)();
+      size_t offset;
+    };
+    typedef std::vector<Field> Fields;
+
+    template <typename V>
+    static Field field(const char *name, V T::*member)
+    {
+      static_assert(std::is_standard_layout<T>::value && std::is_trivially_copyable<T>::value, "record is plain struct");
+      // member address in storage that is never constructed, only offset is taken
+      static const typename std::aligned_storage<sizeof(T), alignof(T)>::type storage = {};
+      const T *object = reinterpret_cast<const T *>(&storage);
+      const size_t offset = reinterpret_cast<const char *>(&(object->*member)) - reinterpret_cast<const char *>(object);
+      return Field{name, &DType<V>::descr, offset};
+    }
+
+    static PyArray_Descr *descr()
+    {
+      std::vector<std::string> names;
+      std::vector<Var> formats;
+      std::vector<size_t> offsets;
+      for (const Field &f : DType<T>::fields())
+      {
+        names.push_back(f.name);
+        formats.push_back(Var::from(reinterpret_cast<PyObject *>(f.descr())));
+        offsets.push_back(f.offset);
+      }
+      return detail::recordDescr(names, formats, offsets, sizeof(T));
+    }
+  };
+
+  /**
+   * Non-owning view of N-dimensional strided array: data pointer, shape and strides in bytes.
+   * Cheap to copy and index, valid while array it refers to is alive.
+   *
+   *   const cppy3::NDView<float> v = tensor.view();
+   *   for (npy_intp t = 0; t < v.dim(0); ++t)
+   *     kernel(v[t].data, v[t].dim(0), v[t].stride(0));
+   */
+  template <typename Type>
+  struct NDView
+  {
+    Type *data;
+    int ndim;
+    const npy_intp *shape;
+    const npy_intp *strides;
+
+    /**
+     * Element at index, one index per dimension
+     */
+    template <typename... Index>
+    Type &operator()(Index... index) const
+    {
+      assert(sizeof...(Index) == static_cast<size_t>(ndim));
+      char *p = reinterpret_cast<char *>(data);
+      int d = 0;
+      // fold over comma, dimensions are visited in order
+      ((assert(static_cast<npy_intp>(index) >= 0 && static_cast<npy_intp>(index) < shape[d]),
+        p += static_cast<npy_intp>(index) * strides[d++]),
+       ...);
+      (void)d;
+      return *reinterpret_cast<Type *>(p);
+    }
+
+    /**
+     * @return sub-view of index i along first dimension, rank is one less
+     */
+    NDView operator[](npy_intp i) const
+    {
+      assert(ndim > 0 && i >= 0 && i < shape[0]);
+      return NDView{reinterpret_cast<Type *>(reinterpret_cast<char *>(data) + i * strides[0]), ndim - 1, shape + 1, strides + 1};
+    }
+
+    npy_intp dim(int n) const
+    {
+      assert(n >= 0 && n < ndim);
+      return shape[n];
+    }
+
+    /** @return distance between neighbour elements along dimension @b n in bytes */
+    npy_intp stride(int n) const
+    {
+      assert(n >= 0 && n < ndim);
+      return strides[n];
+    }
+
+    /** @return number of elements */
+    npy_intp size() const
+    {
+      npy_intp n = 1;
+      for (int d = 0; d < ndim; ++d)
+      {
+        n *= shape[d];
+      }
+      return n;
+    }
+
+    /** @return true when elements are dense in C order, so data can be walked as flat array of size() */
+    bool contiguous() const
+    {
+      npy_intp expected = sizeof(Type);
+      for (int d = ndim - 1; d >= 0; --d)
+      {
+        if (shape[d] != 1 && strides[d] != expected)
+        {
+          return false;
+        }
+        expected *= shape[d];
+      }
+      return true;
+    }
+  };
+
+  /**
+   * Simple wrapper for numpy.ndarray of any rank
    */
   template <typename Type>
   class NDArray
@@ -68,6 +334,35 @@ namespace cppy3
       copy(data, n1, n2);
     }
 
+    /**
+     * Create array of given shape, e.g. NDArray<float>({time, instruments, features})
+     */
+    explicit NDArray(const std::vector<npy_intp> &shape) : _ndarray(NULL)
+    {
+      create(shape);
+    }
+
+    NDArray(const Type *data, const std::vector<npy_intp> &shape) : _ndarray(NULL)
+    {
+      copy(data, shape);
+    }
+
+    /**
+     * Refer to existing ndarray, e.g. one created in python
+     * @throws PythonException if @b array is not ndarray of Type elements
+     */
+    explicit NDArray(PyObject *array) : _ndarray(NULL)
+    {
+      const Var descr = Var::from(reinterpret_cast<PyObject *>(DType<Type>::descr()));
+      if (!array || !PyArray_Check(array) ||
+          !PyArray_EquivTypes(PyArray_DESCR(reinterpret_cast<PyArrayObject *>(array)), reinterpret_cast<PyArray_Descr *>(descr.data())))
+      {
+        throw PythonException("expected numpy.ndarray of matching dtype");
+      }
+      Py_INCREF(array);
+      _ndarray = reinterpret_cast<PyArrayObject *>(array);
+    }
+
     ~NDArray()
     {
       decref();
@@ -80,21 +375,7 @@ namespace cppy3
      */
     void create(int n, bool fillZeros = SLOWER_AND_CLEARNER)
     {
-
-      decref();
-
-      npy_intp dim1[1];
-      dim1[0] = n;
-      Type impltype = 0;
-      if (fillZeros)
-      {
-        _ndarray = (PyArrayObject *)PyArray_ZEROS(1, dim1, toNumpyDType(impltype), 0);
-      }
-      else
-      {
-        _ndarray = (PyArrayObject *)PyArray_SimpleNew(1, dim1, toNumpyDType(impltype));
-      }
-      assert(_ndarray);
+      create(std::vector<npy_intp>{n}, fillZeros);
     }
 
     /**
@@ -105,24 +386,60 @@ namespace cppy3
      */
     void create(size_t n1, size_t n2, bool fillZeros = SLOWER_AND_CLEARNER)
     {
+      create(std::vector<npy_intp>{static_cast<npy_intp>(n1), static_cast<npy_intp>(n2)}, fillZeros);
+    }
+
+    /**
+     * Create C-contiguous array of given shape
+     * @param shape - size of each dimension
+     * @param fillZeros - initialize allocated array with zeros
+     */
+    void create(const std::vector<npy_intp> &shape, bool fillZeros = SLOWER_AND_CLEARNER)
+    {
+      assert(shape.size() <= NPY_MAXDIMS);
+
+      if (const std::shared_ptr<BufferPool> pool = ndarrayPool())
+      {
+        create(shape, *pool, fillZeros);
+        return;
+      }
 
       decref();
 
-      npy_intp dim2[2];
-      dim2[0] = n1;
-      dim2[1] = n2;
-      Type impltype = 0;
+      npy_intp *dims = const_cast<npy_intp *>(shape.data());
+      const int nd = static_cast<int>(shape.size());
+      // both steal descriptor reference
       if (fillZeros)
       {
-        _ndarray = (PyArrayObject *)PyArray_ZEROS(2, dim2, toNumpyDType(impltype), 0);
+        _ndarray = (PyArrayObject *)PyArray_Zeros(nd, dims, DType<Type>::descr(), 0);
       }
       else
       {
-        _ndarray = (PyArrayObject *)PyArray_SimpleNew(2, dim2, toNumpyDType(impltype));
+        _ndarray = (PyArrayObject *)PyArray_NewFromDescr(&PyArray_Type, DType<Type>::descr(), nd, dims, NULL, NULL, 0, NULL);
       }
       assert(_ndarray);
     }
 
+    /**
+     * Create C-contiguous array of given shape in memory of @b pool, block returns to pool with last view of array
+     * @param shape - size of each dimension
+     * @param fillZeros - initialize allocated array with zeros
+     */
+    void create(const std::vector<npy_intp> &shape, BufferPool &pool, bool fillZeros = SLOWER_AND_CLEARNER)
+    {
+      size_t bytes = sizeof(Type);
+      for (npy_intp n : shape)
+      {
+        bytes *= static_cast<size_t>(n);
+      }
+      const std::shared_ptr<void> block = pool.allocate(bytes);
+      wrap(static_cast<Type *>(block.get()), shape, block);
+      if (fillZeros)
+      {
+        std::memset(block.get(), 0, bytes);
+      }
+    }
+
     bool isset()
     {
       return (_ndarray);
@@ -135,9 +452,7 @@ namespace cppy3
      */
     void wrap(Type *data, int n)
     {
-      npy_intp dim1[1];
-      dim1[0] = n;
-      _ndarray = (PyArrayObject *)PyArray_SimpleNewFromData(1, dim1, toNumpyDType(*data), (void *)&data);
+      wrap(data, std::vector<npy_intp>{n});
     }
 
     /**
@@ -149,10 +464,98 @@ namespace cppy3
      */
     void wrap(Type *data, int n1, int n2)
     {
-      npy_intp dim2[2];
-      dim2[0] = n1;
-      dim2[1] = n2;
-      _ndarray = (PyArrayObject *)PyArray_SimpleNewFromData(2, dim2, toNumpyDType(*data), (void *)data);
+      wrap(data, std::vector<npy_intp>{n1, n2});
+    }
+
+    /**
+     * Wrap existing N-d array without copying, Type* data must outlive ndarray
+     * @param shape - size of each dimension
+     * @param strides - distance between elements of each dimension in bytes, C-contiguous if empty
+     */
+    void wrap(Type *data, const std::vector<npy_intp> &shape, const std::vector<npy_intp> &strides = std::vector<npy_intp>())
+    {
+      assert(shape.size() <= NPY_MAXDIMS);
+      assert(strides.empty() || strides.size() == shape.size());
+
+      decref();
+
+      _ndarray = (PyArrayObject *)PyArray_NewFromDescr(&PyArray_Type, DType<Type>::descr(), static_cast<int>(shape.size()),
+                                                       const_cast<npy_intp *>(shape.data()),
+                                                       strides.empty() ? NULL : const_cast<npy_intp *>(strides.data()), data,
+                                                       NPY_ARRAY_WRITEABLE, NULL);
+      assert(_ndarray);
+    }
+
+    /**
+     * Wrap existing N-d array without copying, @b owner keeps data alive as long as ndarray or any python view of it,
+     * e.g. std::shared_ptr<void>(data, free) or shared_ptr of container holding data
+     * @param strides - distance between elements of each dimension in bytes, C-contiguous if empty
+     */
+    void wrap(Type *data, const std::vector<npy_intp> &shape, const std::shared_ptr<void> &owner,
+              const std::vector<npy_intp> &strides = std::vector<npy_intp>())
+    {
+      wrap(data, shape, strides);
+      // ndarray base capsule holds owner, numpy views keep their base alive
+      if (PyArray_SetBaseObject(_ndarray, detail::ownerCapsule(owner)) != 0)
+      {
+        rethrowPythonException();
+      }
+    }
+
+    /**
+     * Hand @b values over to ndarray without copying, vector is kept alive by ndarray
+     */
+    void wrap(std::vector<Type> &&values, const std::vector<npy_intp> &shape)
+    {
+      assert(shape.empty() || static_cast<size_t>(PyArray_MultiplyList(const_cast<npy_intp *>(shape.data()), shape.size())) == values.size());
+      std::shared_ptr<std::vector<Type>> owner = std::make_shared<std::vector<Type>>(std::move(values));
+      wrap(owner->data(), shape, owner);
+    }
+
+    /**
+     * Wrap CPU tensor of C++ library without copying, tensor deleter is called with last view of ndarray.
+     * Ownership of @b tensor is taken even if it is rejected
+     * @throws PythonException if tensor is on other device or of other data type
+     */
+    void fromDLPack(DLManagedTensor *tensor)
+    {
+      const std::shared_ptr<void> owner = detail::dlpackOwner(tensor);
+      const DLTensor &t = tensor->dl_tensor;
+      const std::vector<npy_intp> strides = detail::dlpackStrides(t, dlpackType<Type>(), sizeof(Type));
+      wrap(reinterpret_cast<Type *>(static_cast<char *>(t.data) + t.byte_offset), std::vector<npy_intp>(t.shape, t.shape + t.ndim),
+           owner, strides);
+    }
+
+    /**
+     * Wrap tensor of python object implementing __dlpack__() (torch.Tensor, jax.Array, numpy.ndarray ...)
+     * or "dltensor" capsule without copying, GIL required
+     */
+    void fromDLPack(PyObject *o)
+    {
+      fromDLPack(detail::dlpackImport(o));
+    }
+
+    /**
+     * @return tensor sharing data of array for C++ libraries, caller owns it and must call its deleter.
+     * Array stays alive until then
+     */
+    DLManagedTensor *toDLPack() const
+    {
+      assert(_ndarray);
+      return detail::dlpackExport(_ndarray, dlpackType<Type>());
+    }
+
+    /**
+     * Create C-contiguous Numpy ndarray copy of N-d data
+     * @param data - elements in C order
+     * @param shape - size of each dimension
+     */
+    void copy(const Type *data, const std::vector<npy_intp> &shape)
+    {
+      create(shape, false);
+      // new array is C-contiguous just like data
+      detail::copyStrided(getData(), PyArray_STRIDES(_ndarray), data, PyArray_STRIDES(_ndarray), PyArray_DIMS(_ndarray),
+                          PyArray_NDIM(_ndarray), sizeof(Type));
     }
 
     /**
@@ -162,12 +565,7 @@ namespace cppy3
      */
     void copy(const Type *data, int n)
     {
-      create(n, false);
-
-      for (int i = 0; i < n; i++)
-      {
-        *(Type *)(PyArray_GETPTR1(_ndarray, i)) = data[i];
-      }
+      copy(data, std::vector<npy_intp>{n});
     }
 
     /**
@@ -178,31 +576,53 @@ namespace cppy3
      */
     void copy(const Type *data, size_t n1, size_t n2)
     {
-      create(n1, n2, false);
-      for (size_t r = 0; r < n1; ++r)
+      copy(data, std::vector<npy_intp>{static_cast<npy_intp>(n1), static_cast<npy_intp>(n2)});
+    }
+
+    /**
+     * Create C-contiguous Numpy ndarray copy of strided data, e.g. block of C++ matrix or view of another array.
+     * Source must not be view of this array, which is replaced
+     */
+    void copy(const NDView<Type> &source)
+    {
+      create(std::vector<npy_intp>(source.shape, source.shape + source.ndim), false);
+      detail::copyStrided(getData(), PyArray_STRIDES(_ndarray), source.data, source.strides, source.shape, source.ndim, sizeof(Type));
+    }
+
+    /**
+     * Copy elements to @b out in C order, whatever layout array has
+     * @param out - room for size() elements
+     */
+    void copyTo(Type *out) const
+    {
+      const NDView<Type> v = view();
+      std::vector<npy_intp> strides(v.ndim);
+      npy_intp stride = sizeof(Type);
+      for (int d = v.ndim - 1; d >= 0; --d)
       {
-        size_t rowOffset = r * n2;
-        for (size_t c = 0; c < n2; ++c)
-        {
-          *(Type *)PyArray_GETPTR2(_ndarray, r, c) = data[rowOffset + c];
-        }
+        strides[d] = stride;
+        stride *= v.shape[d];
       }
+      detail::copyStrided(out, strides.data(), v.data, v.strides, v.shape, v.ndim, sizeof(Type));
     }
 
-    Type &operator()(int i)
+    /**
+     * Element at index, one index per dimension, e.g. a(t, instrument, feature)
+     */
+    template <typename... Index>
+    Type &operator()(Index... index)
     {
-      assert(_ndarray);
-      assert(PyArray_NDIM(_ndarray) == 1 && i >= 0 && i < PyArray_DIM(_ndarray, 0));
-      return *((Type *)PyArray_GETPTR1(_ndarray, i));
+      return view()(index...);
     }
 
-    Type &operator()(int i, int j)
+    /**
+     * @return view for kernels iterating raw data, valid while array is alive
+     */
+    NDView<Type> view() const
     {
       assert(_ndarray);
-      assert(PyArray_NDIM(_ndarray) == 2);
-      assert(i >= 0 && i < PyArray_DIM(_ndarray, 0));
-      assert(j >= 0 && j < PyArray_DIM(_ndarray, 1));
-      return *((Type *)PyArray_GETPTR2(_ndarray, i, j));
+      return NDView<Type>{static_cast<Type *>(PyArray_DATA(_ndarray)), PyArray_NDIM(_ndarray), PyArray_DIMS(_ndarray),
+                          PyArray_STRIDES(_ndarray)};
     }
 
     operator PyObject *()
@@ -228,19 +648,46 @@ namespace cppy3
     /**
      * @return size of dimension n
      */
-    int dim(size_t n) const
+    npy_intp dim(size_t n) const
     {
       assert(_ndarray);
-      assert(PyArray_NDIM(_ndarray) > n);
+      assert(static_cast<size_t>(PyArray_NDIM(_ndarray)) > n);
       return PyArray_DIM(_ndarray, n);
     }
 
-    int dim1() const
+    /**
+     * @return sizes of all dimensions
+     */
+    std::vector<npy_intp> shape() const
+    {
+      assert(_ndarray);
+      return std::vector<npy_intp>(PyArray_DIMS(_ndarray), PyArray_DIMS(_ndarray) + PyArray_NDIM(_ndarray));
+    }
+
+    /**
+     * @return strides of all dimensions in bytes
+     */
+    std::vector<npy_intp> strides() const
+    {
+      assert(_ndarray);
+      return std::vector<npy_intp>(PyArray_STRIDES(_ndarray), PyArray_STRIDES(_ndarray) + PyArray_NDIM(_ndarray));
+    }
+
+    /**
+     * @return number of elements
+     */
+    npy_intp size() const
+    {
+      assert(_ndarray);
+      return PyArray_SIZE(_ndarray);
+    }
+
+    npy_intp dim1() const
     {
       return dim(1);
     }
 
-    int dim2() const
+    npy_intp dim2() const
     {
       return dim(2);
     }
@@ -251,7 +698,7 @@ namespace cppy3
     Type *getData()
     {
       assert(_ndarray);
-      return PyArray_DATA(_ndarray);
+      return static_cast<Type *>(PyArray_DATA(_ndarray));
     }
 
   private:
@@ -259,7 +706,7 @@ namespace cppy3
 
     void decref()
     {
-      Py_XDECREF(_ndarray);
+      Py_CLEAR(_ndarray);
     }
   };
 
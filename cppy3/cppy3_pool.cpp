@@ -0,0 +1,234 @@
+#include "cppy3_pool.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace cppy3
+{
+
+  namespace
+  {
+    const size_t MIN_BLOCK = 64;
+    const size_t HUGE_PAGE = size_t(2) << 20;
+
+    size_t floorLog2(size_t n)
+    {
+      size_t r = 0;
+      while (n >>= 1)
+      {
+        ++r;
+      }
+      return r;
+    }
+
+    size_t roundUp(size_t n, size_t step)
+    {
+      return (n + step - 1) / step * step;
+    }
+  }
+
+  /** shared by pool and deleters of blocks handed out, so blocks can outlive pool */
+  struct BufferPool::State
+  {
+    Options options;
+    mutable std::mutex mutex;
+    std::map<size_t, std::vector<void *>> free;
+    Stats stats;
+
+    bool huge(size_t size) const
+    {
+#if defined(__linux__)
+      return options.hugePages && size >= HUGE_PAGE;
+#else
+      (void)size;
+      return false;
+#endif
+    }
+
+    void *systemAllocate(size_t size)
+    {
+#if defined(__linux__)
+      if (huge(size))
+      {
+        // over-map by a huge page to cut 2MB aligned range out of it
+        const size_t mapped = size + HUGE_PAGE;
+        void *p = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+        {
+          throw std::bad_alloc();
+        }
+        char *begin = static_cast<char *>(p);
+        char *aligned = reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(begin), HUGE_PAGE));
+        if (aligned > begin)
+        {
+          munmap(begin, aligned - begin);
+        }
+        if (begin + mapped > aligned + size)
+        {
+          munmap(aligned + size, begin + mapped - (aligned + size));
+        }
+        madvise(aligned, size, MADV_HUGEPAGE);
+        return aligned;
+      }
+#endif
+#if defined(_WIN32)
+      void *p = _aligned_malloc(size, options.alignment);
+#else
+      void *p = std::aligned_alloc(options.alignment, roundUp(size, options.alignment));
+#endif
+      if (p == NULL)
+      {
+        throw std::bad_alloc();
+      }
+      return p;
+    }
+
+    void systemFree(void *p, size_t size)
+    {
+#if defined(__linux__)
+      if (huge(size))
+      {
+        munmap(p, size);
+        return;
+      }
+#endif
+#if defined(_WIN32)
+      _aligned_free(p);
+#else
+      std::free(p);
+#endif
+    }
+
+    void release(void *p, size_t size)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.inUseBytes -= size;
+        if (stats.cachedBytes + size <= options.maxCachedBytes)
+        {
+          free[size].push_back(p);
+          stats.cachedBytes += size;
+          return;
+        }
+        ++stats.systemFrees;
+      }
+      systemFree(p, size);
+    }
+
+    ~State()
+    {
+      for (auto &sizeBlocks : free)
+      {
+        for (void *p : sizeBlocks.second)
+        {
+          systemFree(p, sizeBlocks.first);
+        }
+      }
+    }
+  };
+
+  LIB_API BufferPool::BufferPool() : BufferPool(Options())
+  {
+  }
+
+  LIB_API BufferPool::BufferPool(const Options &options) : _state(std::make_shared<State>())
+  {
+    assert(options.alignment >= sizeof(void *) && (options.alignment & (options.alignment - 1)) == 0);
+    _state->options = options;
+  }
+
+  LIB_API BufferPool::~BufferPool()
+  {
+  }
+
+  LIB_API size_t BufferPool::sizeClass(size_t bytes) const
+  {
+    if (bytes <= MIN_BLOCK)
+    {
+      return MIN_BLOCK;
+    }
+    // four classes per power of two keep waste under 25%
+    const size_t step = size_t(1) << (floorLog2(bytes - 1) - 2);
+    const size_t size = roundUp(bytes, step);
+    return _state->huge(size) ? roundUp(size, HUGE_PAGE) : size;
+  }
+
+  LIB_API std::shared_ptr<void> BufferPool::allocate(size_t bytes)
+  {
+    const size_t size = sizeClass(bytes);
+    void *p = NULL;
+    {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      ++_state->stats.requests;
+      _state->stats.inUseBytes += size;
+      auto cached = _state->free.find(size);
+      if (cached != _state->free.end() && !cached->second.empty())
+      {
+        p = cached->second.back();
+        cached->second.pop_back();
+        _state->stats.cachedBytes -= size;
+        ++_state->stats.reused;
+      }
+      else
+      {
+        ++_state->stats.systemAllocations;
+      }
+    }
+
+    if (p == NULL)
+    {
+      try
+      {
+        p = _state->systemAllocate(size);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        _state->stats.inUseBytes -= size;
+        --_state->stats.systemAllocations;
+        throw;
+      }
+    }
+    const std::shared_ptr<State> state = _state;
+    return std::shared_ptr<void>(p, [state, size](void *block) { state->release(block, size); });
+  }
+
+  LIB_API BufferPool::Stats BufferPool::stats() const
+  {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    return _state->stats;
+  }
+
+  LIB_API void BufferPool::trim()
+  {
+    std::map<size_t, std::vector<void *>> blocks;
+    {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      blocks.swap(_state->free);
+      for (const auto &sizeBlocks : blocks)
+      {
+        _state->stats.systemFrees += sizeBlocks.second.size();
+      }
+      _state->stats.cachedBytes = 0;
+    }
+    for (const auto &sizeBlocks : blocks)
+    {
+      for (void *p : sizeBlocks.second)
+      {
+        _state->systemFree(p, sizeBlocks.first);
+      }
+    }
+  }
+
+} // namespace
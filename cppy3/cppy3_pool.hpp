@@ -0,0 +1,74 @@
+/**
+ * Size-class pool of aligned memory blocks
+ *
+ * Backing memory of arrays handed to python with identical shapes again and again
+ * is taken from the pool and returned there when the last owner lets it go,
+ * instead of going through the system allocator and faulting fresh pages each time.
+ */
+#pragma once
+
+#include "libdefs.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace cppy3
+{
+
+  class LIB_API BufferPool
+  {
+  public:
+    struct Options
+    {
+      /** block alignment, power of two */
+      size_t alignment = 64;
+      /** free blocks kept for reuse, larger excess goes back to system */
+      size_t maxCachedBytes = size_t(1) << 30;
+      /** blocks of 2MB and more are 2MB aligned and advised for transparent huge pages (Linux) */
+      bool hugePages = true;
+    };
+
+    struct Stats
+    {
+      /** allocate() calls */
+      uint64_t requests = 0;
+      /** requests served by cached block */
+      uint64_t reused = 0;
+      uint64_t systemAllocations = 0;
+      uint64_t systemFrees = 0;
+      /** bytes of free blocks kept */
+      size_t cachedBytes = 0;
+      /** bytes of blocks handed out and not yet returned */
+      size_t inUseBytes = 0;
+
+      double reuseRate() const { return requests ? double(reused) / requests : 0; }
+    };
+
+    BufferPool();
+    explicit BufferPool(const Options &options);
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    /**
+     * @return block of at least @b bytes, returned to pool when last copy of pointer is gone.
+     * Blocks may outlive pool. Thread safe
+     */
+    std::shared_ptr<void> allocate(size_t bytes);
+
+    Stats stats() const;
+
+    /** give cached blocks back to system */
+    void trim();
+
+    /** @return block size serving request of @b bytes */
+    size_t sizeClass(size_t bytes) const;
+
+  private:
+    struct State;
+    std::shared_ptr<State> _state;
+  };
+
+} // namespace
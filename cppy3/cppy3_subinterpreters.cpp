@@ -0,0 +1,237 @@
+#include "cppy3_subinterpreters.hpp"
+
+#if CPPY3_HAVE_SUBINTERPRETERS
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace cppy3
+{
+
+  LIB_API SubInterpreter::SubInterpreter() : _threadState(NULL)
+  {
+    assert(Py_IsInitialized());
+    // creation detaches calling thread from its interpreter, if any
+    PyThreadState *previous = attachedThreadState();
+
+    // isolated interpreter, same as _PyInterpreterConfig_INIT
+    PyInterpreterConfig config;
+    std::memset(&config, 0, sizeof(config));
+    config.use_main_obmalloc = 0;
+    config.allow_fork = 0;
+    config.allow_exec = 0;
+    config.allow_threads = 1;
+    config.allow_daemon_threads = 0;
+    config.check_multi_interp_extensions = 1;
+    config.gil = PyInterpreterConfig_OWN_GIL;
+
+    const PyStatus status = Py_NewInterpreterFromConfig(&_threadState, &config);
+    if (PyStatus_Exception(status))
+    {
+      if (previous && attachedThreadState() != previous)
+      {
+        PyEval_RestoreThread(previous);
+      }
+      throw PythonException(std::string("sub-interpreter creation failed: ") + (status.err_msg ? status.err_msg : ""));
+    }
+
+    PyEval_SaveThread();
+    if (previous)
+    {
+      PyEval_RestoreThread(previous);
+    }
+  }
+
+  LIB_API SubInterpreter::~SubInterpreter()
+  {
+    PyThreadState *previous = attachedThreadState();
+    if (previous != _threadState)
+    {
+      if (previous)
+      {
+        PyEval_SaveThread();
+      }
+      PyEval_RestoreThread(_threadState);
+    }
+    else
+    {
+      previous = NULL;
+    }
+    // leaves no thread state attached
+    Py_EndInterpreter(_threadState);
+    if (previous)
+    {
+      PyEval_RestoreThread(previous);
+    }
+  }
+
+  LIB_API void SubInterpreter::attach()
+  {
+    assert(attachedThreadState() == NULL);
+    PyEval_RestoreThread(_threadState);
+  }
+
+  LIB_API void SubInterpreter::detach()
+  {
+    assert(attachedThreadState() == _threadState);
+    PyEval_SaveThread();
+  }
+
+  LIB_API PyInterpreterState *SubInterpreter::interpreter() const
+  {
+    return PyThreadState_GetInterpreter(_threadState);
+  }
+
+  struct SubInterpreterPool::Worker
+  {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> tasks;
+    bool stop;
+    std::thread thread;
+
+    Worker() : stop(false) {}
+
+    /** @return next task or empty function if queue is empty */
+    std::function<void()> tryPop()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::function<void()> task;
+      if (!tasks.empty())
+      {
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      return task;
+    }
+
+    void run(std::promise<void> &started)
+    {
+      std::unique_ptr<SubInterpreter> interpreter;
+      try
+      {
+        interpreter.reset(new SubInterpreter());
+      }
+      catch (...)
+      {
+        started.set_exception(std::current_exception());
+        return;
+      }
+      started.set_value();
+
+      for (;;)
+      {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          wake.wait(lock, [this]() { return stop || !tasks.empty(); });
+          if (tasks.empty())
+          {
+            break;
+          }
+          task = std::move(tasks.front());
+          tasks.pop_front();
+        }
+
+        // keep GIL of interpreter while there are queued tasks
+        interpreter->attach();
+        for (; task; task = tryPop())
+        {
+          task();
+        }
+        interpreter->detach();
+      }
+    }
+  };
+
+  LIB_API SubInterpreterPool::SubInterpreterPool(size_t size) : _next(0)
+  {
+    assert(Py_IsInitialized());
+    if (size == 0)
+    {
+      size = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // do not hold main interpreter while workers set up their interpreters
+    ScopedGILRelease release;
+    try
+    {
+      for (size_t i = 0; i < size; ++i)
+      {
+        std::promise<void> started;
+        std::future<void> ready = started.get_future();
+        _workers.emplace_back(new Worker());
+        Worker *worker = _workers.back().get();
+        worker->thread = std::thread([worker, &started]() { worker->run(started); });
+        ready.get();
+      }
+    }
+    catch (...)
+    {
+      shutdown();
+      throw;
+    }
+  }
+
+  LIB_API SubInterpreterPool::~SubInterpreterPool()
+  {
+    ScopedGILRelease release;
+    shutdown();
+  }
+
+  void SubInterpreterPool::shutdown()
+  {
+    for (auto &worker : _workers)
+    {
+      {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->stop = true;
+      }
+      worker->wake.notify_one();
+    }
+    for (auto &worker : _workers)
+    {
+      if (worker->thread.joinable())
+      {
+        worker->thread.join();
+      }
+    }
+    _workers.clear();
+  }
+
+  void SubInterpreterPool::post(size_t worker, std::function<void()> task)
+  {
+    assert(worker < _workers.size());
+    Worker &w = *_workers[worker];
+    {
+      std::lock_guard<std::mutex> lock(w.mutex);
+      w.tasks.push_back(std::move(task));
+    }
+    w.wake.notify_one();
+  }
+
+  LIB_API Future<void> SubInterpreterPool::exec(size_t worker, const std::string &script)
+  {
+    return submit(worker, [script]() { cppy3::exec(script); });
+  }
+
+  LIB_API void SubInterpreterPool::execAll(const std::string &script)
+  {
+    std::vector<Future<void>> done;
+    for (size_t i = 0; i < size(); ++i)
+    {
+      done.push_back(exec(i, script));
+    }
+    for (auto &d : done)
+    {
+      d.get();
+    }
+  }
+
+} // namespace
+
+#endif
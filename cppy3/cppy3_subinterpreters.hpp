@@ -0,0 +1,120 @@
+/**
+ * Isolated python sub-interpreters with own GIL (python 3.12+)
+ *
+ * Each SubInterpreterPool worker thread owns one interpreter,
+ * so CPU-bound python code scales across cores instead of serializing on single GIL.
+ * Python objects must never cross interpreters: tasks take and return C++ values only.
+ */
+#pragma once
+
+#include "cppy3.hpp"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if PY_VERSION_HEX >= 0x030C0000
+#define CPPY3_HAVE_SUBINTERPRETERS 1
+#else
+#define CPPY3_HAVE_SUBINTERPRETERS 0
+#endif
+
+#if CPPY3_HAVE_SUBINTERPRETERS
+
+namespace cppy3
+{
+
+  /**
+   * Sub-interpreter with its own GIL, created on the calling thread and left detached.
+   * Must be attached, detached and destroyed on the same thread.
+   * Main interpreter must be initialized.
+   */
+  class LIB_API SubInterpreter
+  {
+  public:
+    SubInterpreter();
+    ~SubInterpreter();
+
+    SubInterpreter(const SubInterpreter &) = delete;
+    SubInterpreter &operator=(const SubInterpreter &) = delete;
+
+    /** make interpreter current on this thread and take its GIL */
+    void attach();
+
+    /** release GIL of interpreter */
+    void detach();
+
+    PyInterpreterState *interpreter() const;
+
+  private:
+    PyThreadState *_threadState;
+  };
+
+  /**
+   * Fixed set of worker threads each pinned to own SubInterpreter.
+   * Tasks run on the worker thread with its interpreter attached,
+   * so all cppy3 functions can be used inside. PythonException thrown by a task
+   * is forwarded through the future with traceback already formatted.
+   */
+  class LIB_API SubInterpreterPool
+  {
+  public:
+    /** @param size - number of interpreters, 0 for number of hardware threads */
+    explicit SubInterpreterPool(size_t size = 0);
+
+    /** runs queued tasks, then shuts interpreters down */
+    ~SubInterpreterPool();
+
+    SubInterpreterPool(const SubInterpreterPool &) = delete;
+    SubInterpreterPool &operator=(const SubInterpreterPool &) = delete;
+
+    size_t size() const { return _workers.size(); }
+
+    /** run @b task in interpreter @b worker */
+    template <typename F>
+    auto submit(size_t worker, F task) -> Future<decltype(task())>
+    {
+      auto packaged = detail::packageTask(std::move(task));
+      post(worker, std::move(packaged.first));
+      return std::move(packaged.second);
+    }
+
+    /** run @b task in next interpreter, round-robin */
+    template <typename F>
+    auto submit(F task) -> Future<decltype(task())>
+    {
+      return submit(_next++ % size(), std::move(task));
+    }
+
+    /** exec script in __main__ of interpreter @b worker */
+    Future<void> exec(size_t worker, const std::string &script);
+
+    /** exec script in every interpreter and wait, e.g. for imports and definitions */
+    void execAll(const std::string &script);
+
+    /**
+     * Call callable by dotted name in __main__ of interpreter @b worker
+     * @return future of result extracted to R
+     */
+    template <typename R, typename... Args>
+    Future<R> call(size_t worker, const std::string &callable, const Args &...args)
+    {
+      return submit(worker, detail::callTask<R>(callable, args...));
+    }
+
+  private:
+    struct Worker;
+
+    void post(size_t worker, std::function<void()> task);
+    void shutdown();
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<size_t> _next;
+  };
+
+} // namespace
+
+#endif
@@ -1,58 +1,421 @@
 #include "utils.hpp"
-#if __cplusplus >= 201703L
-#include <cstdlib>
-#include <cstring>
-#ifdef _WIN32
-#include <wchar.h>
-#endif
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CPPY3_UTF_AVX2 1
+#define CPPY3_UTF_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPPY3_UTF_SSE2 1
 #endif
 
 namespace cppy3
 {
-    std::wstring UTF8ToWide(const std::string &text)
+#ifndef CPPY3_USE_BOOST_CONVERT
+    namespace
+    {
+        const char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+        /** UTF-8 input of this size and longer is sized before decoding */
+        const size_t SIZING_THRESHOLD = 64;
+        const bool WIDE_IS_UTF16 = sizeof(wchar_t) == 2;
+
+        /**
+         * Copy leading ASCII run of @b src widening bytes to wchar_t
+         * processes whole SIMD blocks only, tail is left to the scalar loop
+         * @return number of characters copied
+         */
+        size_t widenAscii(const char *src, size_t size, wchar_t *dst)
+        {
+            size_t i = 0;
+#if CPPY3_UTF_AVX2
+            if (sizeof(wchar_t) == 4)
+            {
+                for (; i + 32 <= size; i += 32)
+                {
+                    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                    if (_mm256_movemask_epi8(bytes) != 0)
+                    {
+                        break;
+                    }
+                    for (size_t k = 0; k < 32; k += 8)
+                    {
+                        const __m128i chunk = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i + k));
+                        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + k), _mm256_cvtepu8_epi32(chunk));
+                    }
+                }
+            }
+#endif
+#if CPPY3_UTF_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= size; i += 16)
+            {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                if (_mm_movemask_epi8(bytes) != 0)
+                {
+                    break;
+                }
+                const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+                const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+                __m128i *out = reinterpret_cast<__m128i *>(dst + i);
+                if (WIDE_IS_UTF16)
+                {
+                    _mm_storeu_si128(out, lo);
+                    _mm_storeu_si128(out + 1, hi);
+                }
+                else
+                {
+                    _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+                    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+                    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+                    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+                }
+            }
+#endif
+            return i;
+        }
+
+        /**
+         * @return number of wchar_t code units valid UTF-8 @b src decodes to:
+         * one per byte other than continuation byte, two per 4-byte sequence lead if wchar_t is UTF-16.
+         * Invalid input decodes to different number of code units
+         */
+        size_t wideLength(const unsigned char *src, size_t size)
+        {
+            size_t length = 0;
+            size_t i = 0;
+#if CPPY3_UTF_SSE2
+            // as signed bytes continuation bytes are -65 and less, 4-byte sequence leads from -16
+            const __m128i lastContinuation = _mm_set1_epi8(static_cast<char>(0xBF));
+            const __m128i beforeLead4 = _mm_set1_epi8(static_cast<char>(0xEF));
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 64 <= size; i += 64)
+            {
+                const __m128i *in = reinterpret_cast<const __m128i *>(src + i);
+                const __m128i bytes[4] = {_mm_loadu_si128(in), _mm_loadu_si128(in + 1), _mm_loadu_si128(in + 2), _mm_loadu_si128(in + 3)};
+                const __m128i any = _mm_or_si128(_mm_or_si128(bytes[0], bytes[1]), _mm_or_si128(bytes[2], bytes[3]));
+                if (_mm_movemask_epi8(any) == 0)
+                {
+                    length += 64;
+                    continue;
+                }
+                // per-byte counters, comparison gives -1 for each counted byte
+                __m128i counts = zero;
+                for (const __m128i &block : bytes)
+                {
+                    counts = _mm_sub_epi8(counts, _mm_cmpgt_epi8(block, lastContinuation));
+                    if (WIDE_IS_UTF16)
+                    {
+                        counts = _mm_sub_epi8(counts, _mm_and_si128(_mm_cmpgt_epi8(block, beforeLead4), _mm_cmplt_epi8(block, zero)));
+                    }
+                }
+                const __m128i sums = _mm_sad_epu8(counts, zero);
+                length += static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+            }
+#endif
+            for (; i < size; ++i)
+            {
+                length += (src[i] & 0xC0) != 0x80;
+                length += WIDE_IS_UTF16 && src[i] >= 0xF0;
+            }
+            return length;
+        }
+
+#if CPPY3_UTF_SSE2
+        /** load 16 wide chars as 16 bytes, @return false if some of them is not ASCII */
+        inline bool loadAscii16(const wchar_t *src, __m128i &bytes)
+        {
+            const __m128i *in = reinterpret_cast<const __m128i *>(src);
+            if (WIDE_IS_UTF16)
+            {
+                const __m128i a = _mm_loadu_si128(in);
+                const __m128i b = _mm_loadu_si128(in + 1);
+                const __m128i high = _mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16(static_cast<short>(0xFF80)));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF)
+                {
+                    return false;
+                }
+                bytes = _mm_packus_epi16(a, b);
+            }
+            else
+            {
+                const __m128i a = _mm_loadu_si128(in);
+                const __m128i b = _mm_loadu_si128(in + 1);
+                const __m128i c = _mm_loadu_si128(in + 2);
+                const __m128i d = _mm_loadu_si128(in + 3);
+                const __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+                const __m128i high = _mm_and_si128(any, _mm_set1_epi32(static_cast<int>(0xFFFFFF80)));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) != 0xFFFF)
+                {
+                    return false;
+                }
+                // values < 0x80 survive signed saturation
+                bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+            }
+            return true;
+        }
+#endif
+
+        /** @return length of leading ASCII run of @b src, whole SIMD blocks only */
+        size_t countAscii(const wchar_t *src, size_t size)
+        {
+            size_t i = 0;
+#if CPPY3_UTF_SSE2
+            __m128i bytes;
+            for (; i + 16 <= size && loadAscii16(src + i, bytes); i += 16)
+            {
+            }
+#endif
+            return i;
+        }
+
+        /** Copy leading ASCII run of @b src narrowing to bytes, whole SIMD blocks only */
+        size_t narrowAscii(const wchar_t *src, size_t size, char *dst)
+        {
+            size_t i = 0;
+#if CPPY3_UTF_SSE2
+            __m128i bytes;
+            for (; i + 16 <= size && loadAscii16(src + i, bytes); i += 16)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), bytes);
+            }
+#endif
+            return i;
+        }
+
+        /**
+         * Read one code point from wide string
+         * lone surrogates and out of range values are replaced with U+FFFD
+         */
+        inline char32_t readWide(const wchar_t *src, size_t size, size_t &i)
+        {
+            const char32_t c = static_cast<char32_t>(src[i++]);
+            if (c < 0xD800)
+            {
+                return c;
+            }
+            if (WIDE_IS_UTF16 && c < 0xDC00 && i < size)
+            {
+                const char32_t low = static_cast<char32_t>(src[i]);
+                if (low >= 0xDC00 && low < 0xE000)
+                {
+                    ++i;
+                    return 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                }
+            }
+            if (c < 0xE000 || c > 0x10FFFF)
+            {
+                return REPLACEMENT_CHARACTER;
+            }
+            return c;
+        }
+
+        inline size_t utf8Length(char32_t c)
+        {
+            return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+        }
+
+        /**
+         * Decode one multibyte UTF-8 sequence starting at src[i] (not ASCII)
+         * invalid, overlong and truncated sequences consume one byte and give U+FFFD
+         */
+        inline char32_t readUTF8(const unsigned char *src, size_t size, size_t &i)
+        {
+            const unsigned char lead = src[i];
+            if ((lead & 0xE0) == 0xC0 && lead >= 0xC2 && i + 1 < size && (src[i + 1] & 0xC0) == 0x80)
+            {
+                // 2-byte fast path: latin, cyrillic, greek...
+                const char32_t c = (static_cast<char32_t>(lead & 0x1F) << 6) | (src[i + 1] & 0x3F);
+                i += 2;
+                return c;
+            }
+            size_t length = 0;
+            char32_t c = 0;
+            char32_t min = 0;
+            if ((lead & 0xE0) == 0xC0)
+            {
+                length = 2;
+                c = lead & 0x1F;
+                min = 0x80;
+            }
+            else if ((lead & 0xF0) == 0xE0)
+            {
+                length = 3;
+                c = lead & 0x0F;
+                min = 0x800;
+            }
+            else if ((lead & 0xF8) == 0xF0)
+            {
+                length = 4;
+                c = lead & 0x07;
+                min = 0x10000;
+            }
+            else
+            {
+                ++i;
+                return REPLACEMENT_CHARACTER;
+            }
+
+            if (i + length > size)
+            {
+                ++i;
+                return REPLACEMENT_CHARACTER;
+            }
+            for (size_t k = 1; k < length; ++k)
+            {
+                const unsigned char next = src[i + k];
+                if ((next & 0xC0) != 0x80)
+                {
+                    ++i;
+                    return REPLACEMENT_CHARACTER;
+                }
+                c = (c << 6) | (next & 0x3F);
+            }
+            if (c < min || c > 0x10FFFF || (c >= 0xD800 && c < 0xE000))
+            {
+                ++i;
+                return REPLACEMENT_CHARACTER;
+            }
+            i += length;
+            return c;
+        }
+    }
+#endif
+
+    std::wstring UTF8ToWide(const char *text, size_t size)
     {
 #ifdef CPPY3_USE_BOOST_CONVERT
         using boost::locale::conv::utf_to_utf;
-        return utf_to_utf<wchar_t>(text.c_str(), text.c_str() + text.size())
-#elif __cplusplus >= 201703L 
-        std::mbstate_t state{};
-        const char *narrow = text.c_str();
-        std::size_t len = std::strlen(narrow) * 2;
-        wchar_t *wide = (wchar_t *)malloc(sizeof(wchar_t) * (len + 1));
-#ifdef _WIN32
-        mbstowcs_s(&len, wide, len, narrow, len);
+        return utf_to_utf<wchar_t>(text, text + size);
 #else
-        std::mbsrtowcs(wide, &narrow, len, &state);
-#endif
-        std::wstring result(wide);
-        free(wide);
+        const unsigned char *src = reinterpret_cast<const unsigned char *>(text);
+        // sizing pass, exact unless input has invalid sequences.
+        // Short text takes input size as upper bound, filling that is cheaper than sizing
+        bool exact = size >= SIZING_THRESHOLD;
+        std::wstring result(exact ? wideLength(src, size) : size, L'\0');
+        wchar_t *out = &result[0];
+        size_t i = 0;
+        while (i < size)
+        {
+            if (src[i] < 0x80)
+            {
+                const size_t ascii = widenAscii(text + i, size - i, out);
+                i += ascii;
+                out += ascii;
+                while (i < size && src[i] < 0x80)
+                {
+                    *out++ = static_cast<wchar_t>(src[i++]);
+                }
+                continue;
+            }
+
+            // run of multibyte sequences
+            do
+            {
+                const size_t start = i;
+                const char32_t c = readUTF8(src, size, i);
+                if (exact && c == REPLACEMENT_CHARACTER && i == start + 1)
+                {
+                    // each byte from here gives at most one code unit
+                    exact = false;
+                    const size_t written = out - result.data();
+                    result.resize(written + size - start);
+                    out = &result[written];
+                }
+                if (WIDE_IS_UTF16 && c >= 0x10000)
+                {
+                    *out++ = static_cast<wchar_t>(0xD800 + ((c - 0x10000) >> 10));
+                    *out++ = static_cast<wchar_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+                }
+                else
+                {
+                    *out++ = static_cast<wchar_t>(c);
+                }
+            } while (i < size && src[i] >= 0x80);
+        }
+        if (!exact)
+        {
+            result.resize(out - result.data());
+        }
         return result;
-#else
-        std::wstring_convert<std::codecvt_utf8_utf16<wchar_t, 0x10ffff, std::little_endian>> converter;
-        return converter.from_bytes(text);
 #endif
     }
 
-    std::string WideToUTF8(const std::wstring &text)
+    std::wstring UTF8ToWide(const std::string &text)
+    {
+        return UTF8ToWide(text.data(), text.size());
+    }
+
+    std::string WideToUTF8(const wchar_t *text, size_t size)
     {
 #ifdef CPPY3_USE_BOOST_CONVERT
         using boost::locale::conv::utf_to_utf;
-        return utf_to_utf<char>(text.c_str(), text.c_str() + text.size());
-#elif __cplusplus >= 201703L
-        const wchar_t *wide = text.c_str();
-        std::size_t len = text.size() * 2;
-        char *narrow = (char *)malloc(sizeof(char) * (len + 1));
-#ifdef _WIN32
-        wcstombs_s(&len, narrow, len, wide, len);
+        return utf_to_utf<char>(text, text + size);
 #else
-        std::wcstombs(narrow, wide, len);
-#endif
-        std::string result(narrow);
-        free(narrow);
+        // sizing pass
+        size_t length = 0;
+        for (size_t i = 0; i < size;)
+        {
+            if (static_cast<char32_t>(text[i]) < 0x80)
+            {
+                const size_t ascii = countAscii(text + i, size - i);
+                i += ascii;
+                length += ascii;
+                for (; i < size && static_cast<char32_t>(text[i]) < 0x80; ++i)
+                {
+                    ++length;
+                }
+                continue;
+            }
+            length += utf8Length(readWide(text, size, i));
+        }
+
+        std::string result(length, '\0');
+        char *out = &result[0];
+        for (size_t i = 0; i < size;)
+        {
+            if (static_cast<char32_t>(text[i]) < 0x80)
+            {
+                const size_t ascii = narrowAscii(text + i, size - i, out);
+                i += ascii;
+                out += ascii;
+                for (; i < size && static_cast<char32_t>(text[i]) < 0x80; ++i)
+                {
+                    *out++ = static_cast<char>(text[i]);
+                }
+                continue;
+            }
+            const char32_t c = readWide(text, size, i);
+            if (c < 0x80)
+            {
+                *out++ = static_cast<char>(c);
+            }
+            else if (c < 0x800)
+            {
+                *out++ = static_cast<char>(0xC0 | (c >> 6));
+                *out++ = static_cast<char>(0x80 | (c & 0x3F));
+            }
+            else if (c < 0x10000)
+            {
+                *out++ = static_cast<char>(0xE0 | (c >> 12));
+                *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                *out++ = static_cast<char>(0x80 | (c & 0x3F));
+            }
+            else
+            {
+                *out++ = static_cast<char>(0xF0 | (c >> 18));
+                *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                *out++ = static_cast<char>(0x80 | (c & 0x3F));
+            }
+        }
         return result;
-#else
-        std::wstring_convert<std::codecvt_utf8<wchar_t, 0x10ffff, std::little_endian>, wchar_t> converter;
-        return converter.to_bytes(text);
 #endif
     }
+
+    std::string WideToUTF8(const std::wstring &text)
+    {
+        return WideToUTF8(text.data(), text.size());
+    }
 }
@@ -5,8 +5,6 @@
 
 #ifdef CPPY3_USE_BOOST_CONVERT
     #include <boost/locale/encoding_utf.hpp>
-#else
-    #include <codecvt>
 #endif
 
 #ifndef _NDEBUG
@@ -17,8 +15,14 @@
  #define DWLOG(MSG) {}
 #endif
 
-namespace cppy3 
+namespace cppy3
 {
+    /**
+     * Locale independent UTF-8 <-> wchar_t (UTF-32 or UTF-16 on Windows) converters
+     * Invalid input sequences are replaced with U+FFFD
+     */
     std::wstring UTF8ToWide(const std::string& text);
+    std::wstring UTF8ToWide(const char* text, size_t size);
     std::string WideToUTF8(const std::wstring& text);
+    std::string WideToUTF8(const wchar_t* text, size_t size);
 }
@@ -1,32 +1,16 @@
 #include <iostream>
 #include "cppy3/cppy3.hpp"
+#include "cppy3/cppy3_module.hpp"
 
-static PyObject* hello(PyObject *self, PyObject *args, PyObject *keywds)
-{
-    const char *name = "";    
-    static char *kwlist[] = {(char*)"name", NULL};
-
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "s", kwlist, &name))
-        return NULL;
-
-    printf("Hello! I am %s.\n", name);
-
-    Py_RETURN_NONE;
-}
-
-static PyMethodDef EmbMethods[] = {
-    {"hello", (PyCFunction)(void(*)(void))hello, METH_VARARGS | METH_KEYWORDS, "Say hello."},
-    {NULL, NULL, 0, NULL} /* Sentinel */
-};
-
-static PyModuleDef EmbModule = {
-    PyModuleDef_HEAD_INIT, "emb", NULL, -1, EmbMethods
-};
+// C++ functions callable from the console as emb.hello(name)
+static const cppy3::Module emb = cppy3::Module("emb")
+    .def("hello", [](const std::string &name) { std::cout << "Hello! I am " << name << "." << std::endl; },
+         {"name"}, "Say hello.");
 
 static PyObject*
 PyInit_emb(void)
 {
-    return PyModule_Create(&EmbModule);
+    return emb.create();
 }
 
 int main(int argc, char *argv[])
@@ -1,12 +1,40 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <clocale>
 #include <thread>
 
 #include <cppy3/cppy3.hpp>
+#include <cppy3/cppy3_buffer.hpp>
+#include <cppy3/cppy3_class.hpp>
+#include <cppy3/cppy3_executor.hpp>
+#include <cppy3/cppy3_gilstats.hpp>
+#include <cppy3/cppy3_module.hpp>
+#include <cppy3/cppy3_subinterpreters.hpp>
 #if CPPY3_BUILT_WITH_NUMPY
 #include <cppy3/cppy3_numpy.hpp>
+
+struct TestQuote {
+  int64_t time;
+  float bid;
+  float ask;
+  int32_t sizes[2];
+};
+
+template <>
+struct cppy3::DType<TestQuote> : cppy3::RecordDType<TestQuote> {
+  static Fields fields() {
+    return {field("time", &TestQuote::time), field("bid", &TestQuote::bid), field("ask", &TestQuote::ask), field("sizes", &TestQuote::sizes)};
+  }
+};
 #endif
 
+struct UnconvertibleArgument {};
+
+PyObject *convert(const UnconvertibleArgument &) {
+  throw std::runtime_error("argument cannot be converted");
+}
+
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 
@@ -22,14 +50,17 @@ TEST_CASE( "Utils", "" ) {
     const std::wstring unicodeStr(L"зачем вы посетили нас в глуши забытого селенья");
 
 #if 1
+    // locale affects console output only, converters are locale independent
     constexpr char locale_name[] = "en_US.UTF-8";
-    setlocale( LC_ALL, locale_name );
-    std::locale::global(std::locale(locale_name));
-    std::wcin.imbue(std::locale());
-    std::wcout.imbue(std::locale());
-    std::ios_base::sync_with_stdio(false);
+    const bool hasLocale = setlocale( LC_ALL, locale_name ) != NULL;
+    if (hasLocale) {
+      std::locale::global(std::locale(locale_name));
+      std::wcin.imbue(std::locale());
+      std::wcout.imbue(std::locale());
+    }
 #else
 #include <codecvt>
+    const bool hasLocale = true;
     std::ios_base::sync_with_stdio(false);
     std::locale utf8(std::locale(), new std::codecvt_utf8<wchar_t>);
     std::wcout.imbue(utf8);
@@ -37,15 +68,70 @@ TEST_CASE( "Utils", "" ) {
     std::cout << utf8Str << std::endl;
     std::cout << "Unicode->UTF8:" << cppy3::WideToUTF8(unicodeStr) << std::endl;
 
-    std::wcout << unicodeStr << std::endl;
-    std::wcout << "UTF8->Unicode:" << cppy3::UTF8ToWide(utf8Str) << std::endl;
+    if (hasLocale) {
+      std::wcout << unicodeStr << std::endl;
+      std::wcout << "UTF8->Unicode:" << cppy3::UTF8ToWide(utf8Str) << std::endl;
+    }
 
     REQUIRE(cppy3::WideToUTF8(unicodeStr) == utf8Str);
     REQUIRE(cppy3::UTF8ToWide(utf8Str) == unicodeStr);
   }
+
+  SECTION( "unicode converters edge cases" ) {
+    REQUIRE(cppy3::UTF8ToWide(std::string()).empty());
+    REQUIRE(cppy3::WideToUTF8(std::wstring()).empty());
+
+    // long ascii runs and mixed tails go through vectorized and scalar paths
+    std::string ascii;
+    for (int i = 0; i < 100; ++i) {
+      ascii += static_cast<char>('a' + i % 26);
+    }
+    const std::wstring wideAscii(ascii.begin(), ascii.end());
+    REQUIRE(cppy3::UTF8ToWide(ascii) == wideAscii);
+    REQUIRE(cppy3::WideToUTF8(wideAscii) == ascii);
+    REQUIRE(cppy3::UTF8ToWide(ascii + "\xc3\xa9" + ascii) == wideAscii + L"\u00e9" + wideAscii);
+    REQUIRE(cppy3::WideToUTF8(wideAscii + L"\u00e9" + wideAscii) == ascii + "\xc3\xa9" + ascii);
+
+    // supplementary plane round trip
+    const std::string smile("\xf0\x9f\x98\x80");
+    REQUIRE(cppy3::WideToUTF8(cppy3::UTF8ToWide(smile)) == smile);
+    REQUIRE(cppy3::UTF8ToWide(smile).size() == (sizeof(wchar_t) == 2 ? 2 : 1));
+
+    // invalid, overlong and truncated sequences are replaced
+    REQUIRE(cppy3::UTF8ToWide("a\xff" "b") == L"a\ufffd" L"b");
+    REQUIRE(cppy3::UTF8ToWide("\xc0\xaf") == L"\ufffd\ufffd");
+    REQUIRE(cppy3::UTF8ToWide("\xe2\x82") == L"\ufffd\ufffd");
+    // long text is sized before decoding, invalid sequences give more or fewer code units than expected
+    REQUIRE(cppy3::UTF8ToWide(ascii + "\xc0\xaf" + ascii) == wideAscii + L"\ufffd\ufffd" + wideAscii);
+    REQUIRE(cppy3::UTF8ToWide(ascii + "\xf8" + ascii + "\xe2\x82") == wideAscii + L"\ufffd" + wideAscii + L"\ufffd\ufffd");
+    REQUIRE(cppy3::UTF8ToWide(ascii + smile + "\xd0\xb7") == wideAscii + cppy3::UTF8ToWide(smile) + L"\u0437");
+  }
 #endif
 }
 
+TEST_CASE( "buffer outliving interpreter", "" ) {
+  // python buffer viewed from C++ is dropped after finalization, it is left alone then
+  cppy3::BufferArray<uint8_t> late;
+  {
+    cppy3::PythonVM instance;
+    late = cppy3::BufferArray<uint8_t>(cppy3::eval("bytearray(b'abc')"));
+    REQUIRE(late(1) == 'b');
+  }
+  REQUIRE(!Py_IsInitialized());
+  // or while next interpreter runs, exporter belongs to previous one
+  late = cppy3::BufferArray<uint8_t>();
+  cppy3::BufferArray<uint8_t> restarted;
+  {
+    cppy3::PythonVM instance;
+    restarted = cppy3::BufferArray<uint8_t>(cppy3::eval("bytearray(b'abc')"));
+  }
+  {
+    cppy3::PythonVM instance;
+    restarted = cppy3::BufferArray<uint8_t>();
+    REQUIRE(cppy3::eval("1 + 1").toLong() == 2);
+  }
+}
+
 TEST_CASE( "cppy3: Embedding Python into C++ code", "main funcs" ) {
   // create interpreter
   cppy3::PythonVM instance;
@@ -98,6 +184,350 @@ TEST_CASE( "cppy3: Embedding Python into C++ code", "main funcs" ) {
     REQUIRE(uVar2 == unicodeStr);
   }
 
+  SECTION("var ownership") {
+    static_assert(std::is_nothrow_move_constructible<cppy3::Var>::value, "");
+    static_assert(std::is_nothrow_move_assignable<cppy3::Var>::value, "");
+
+    PyObject *o = PyList_New(0);
+    cppy3::Var a = cppy3::Var::from(o);
+    REQUIRE(Py_REFCNT(o) == 1);
+
+    // move transfers reference as is
+    cppy3::Var b(std::move(a));
+    REQUIRE(a.null());
+    REQUIRE(Py_REFCNT(o) == 1);
+
+    // copy assignment shares it
+    cppy3::Var c = cppy3::eval("[]");
+    c = b;
+    REQUIRE(c.data() == o);
+    REQUIRE(Py_REFCNT(o) == 2);
+    c = c;
+    REQUIRE(Py_REFCNT(o) == 2);
+
+    // move assignment releases previous object
+    cppy3::Var d = cppy3::Var::from(PyList_New(0));
+    PyObject *other = d.data();
+    Py_INCREF(other);
+    d = std::move(b);
+    REQUIRE(b.null());
+    REQUIRE(Py_REFCNT(o) == 2);
+    REQUIRE(Py_REFCNT(other) == 1);
+    Py_DECREF(other);
+
+    swap(c, d);
+    REQUIRE(Py_REFCNT(o) == 2);
+
+    PyObject *released = d.release();
+    REQUIRE(d.null());
+    REQUIRE(Py_REFCNT(o) == 2);
+    Py_DECREF(released);
+
+    // call() and toString() leave arguments untouched
+    const cppy3::Var text = cppy3::Var::from(PyUnicode_FromString("refcount"));
+    REQUIRE(c.toString() == L"[]");
+    REQUIRE(text.toString() == L"refcount");
+    REQUIRE(Py_REFCNT(text.data()) == 1);
+    cppy3::exec("def identity(x):\n  return x");
+    const cppy3::Var same = cppy3::Var::from(cppy3::call("identity", {text}));
+    REQUIRE(Py_REFCNT(text.data()) == 2);
+  }
+
+  SECTION("compiled code cache") {
+    const cppy3::CodeCacheStats initial = cppy3::codeCacheStats();
+    for (int i = 0; i < 10; ++i) {
+      cppy3::exec("x = 40 + 2");
+    }
+    REQUIRE(cppy3::eval("x").toLong() == 42);
+    REQUIRE(cppy3::eval("x").toLong() == 42);
+
+    cppy3::CodeCacheStats stats = cppy3::codeCacheStats();
+    REQUIRE(stats.misses == initial.misses + 2);
+    REQUIRE(stats.hits == initial.hits + 10);
+
+    // statements passed to eval() are classified once and executed
+    for (int i = 0; i < 3; ++i) {
+      REQUIRE(cppy3::eval("x += 1").none());
+    }
+    REQUIRE(cppy3::eval("x").toLong() == 45);
+    stats = cppy3::codeCacheStats();
+    REQUIRE(stats.misses == initial.misses + 3);
+    REQUIRE_THROWS_AS(cppy3::eval("x +"), cppy3::PythonException);
+    REQUIRE_THROWS_AS(cppy3::eval("undefined_name"), cppy3::PythonException);
+    REQUIRE(!cppy3::error());
+
+    // least recently used code is evicted
+    cppy3::setCodeCacheCapacity(2);
+    cppy3::exec("y = 1");
+    cppy3::exec("y = 2");
+    stats = cppy3::codeCacheStats();
+    REQUIRE(stats.size == 2);
+    REQUIRE(stats.evictions >= 2);
+
+    // failed compilation is not cached and error is forwarded
+    REQUIRE_THROWS_AS(cppy3::exec("y = = 3"), cppy3::PythonException);
+    REQUIRE(!cppy3::error());
+
+    // without cache eval() still tells statements from expressions
+    cppy3::setCodeCacheCapacity(0);
+    REQUIRE(cppy3::eval("y += 1").none());
+    REQUIRE(cppy3::eval("(y,\n y)").toString() == L"(3, 3)");
+    REQUIRE(cppy3::eval("y = 5\ny").none());
+    REQUIRE(cppy3::eval("y").toLong() == 5);
+    REQUIRE(!cppy3::error());
+    cppy3::setCodeCacheCapacity(256);
+
+    cppy3::clearCodeCache();
+    REQUIRE(cppy3::codeCacheStats().size == 0);
+  }
+
+  SECTION("precompiled script") {
+    const cppy3::Script script("counter = globals().get('counter', 0) + 1");
+    for (int i = 0; i < 3; ++i) {
+      script.exec();
+    }
+    REQUIRE(cppy3::eval("counter").toLong() == 3);
+
+    // exec in own namespace
+    cppy3::Var globals = cppy3::Var::from(PyDict_New());
+    script.exec(globals);
+    REQUIRE(cppy3::Dict(globals).var("counter").toLong() == 1);
+    REQUIRE(cppy3::eval("counter").toLong() == 3);
+
+    // expression script returns its value
+    const cppy3::Script expr(L"counter * 2", "<expr>", Py_eval_input);
+    REQUIRE(expr.exec().toLong() == 6);
+
+    REQUIRE_THROWS_AS(cppy3::Script("def"), cppy3::PythonException);
+    REQUIRE_THROWS_AS(cppy3::Script::fromFile("/nonexistent/script.py"), cppy3::PythonException);
+  }
+
+  SECTION("vectorcall") {
+    cppy3::exec("def join(*args):\n  return ','.join(str(a) for a in args)");
+    const cppy3::Var join = cppy3::lookupCallable(cppy3::getMainModule(), L"join");
+
+    REQUIRE(cppy3::vectorcall(cppy3::eval("int")).toLong() == 0);
+    const cppy3::Var pyArg = cppy3::eval("[1]");
+    const cppy3::Var result = cppy3::vectorcall(join, 1, 2.5, std::wstring(L"three"), pyArg);
+    // args are released, result is owned
+    REQUIRE(Py_REFCNT(pyArg.data()) == 1);
+    REQUIRE(Py_REFCNT(result.data()) == 1);
+    REQUIRE(result.toString() == L"1,2.5,three,[1]");
+    // arguments converted before throwing conversion are released
+    REQUIRE_THROWS_AS(cppy3::vectorcall(join, pyArg, UnconvertibleArgument()), std::runtime_error);
+    REQUIRE(Py_REFCNT(pyArg.data()) == 1);
+
+    cppy3::exec("def fail():\n  raise ValueError('vectorcall-error')");
+    try {
+      cppy3::vectorcall(cppy3::lookupCallable(cppy3::getMainModule(), L"fail"));
+      REQUIRE(false);  // unreachable code, expect an exception
+    } catch (const cppy3::PythonException& e) {
+      REQUIRE(e.info.reason == L"vectorcall-error");
+    }
+    REQUIRE(!cppy3::error());
+  }
+
+  SECTION("callable handles") {
+    cppy3::exec("def f(x):\n  return x + 1");
+    cppy3::Function f(L"f");
+    cppy3::Function fRefreshed(L"f", true);
+    REQUIRE(f(1).toLong() == 2);
+    REQUIRE(!f.rebound());
+
+    // rebind name: plain handle keeps old callable, auto-refreshed one follows
+    cppy3::exec("def f(x):\n  return x + 2");
+    REQUIRE(f.rebound());
+    REQUIRE(f(1).toLong() == 2);
+    REQUIRE(fRefreshed(1).toLong() == 3);
+    f.refresh();
+    REQUIRE(f(1).toLong() == 3);
+
+    // dotted path
+    cppy3::exec("import os");
+    cppy3::Function basename(L"os.path.basename", true);
+    REQUIRE(basename(std::wstring(L"dir/file")).toString() == L"file");
+
+    // bound methods are fresh objects on each lookup, yet not rebound
+    cppy3::exec("class Counter:\n  def __init__(self): self.n = 0\n  def add(self, k): self.n += k; return self.n\n"
+                "counter = Counter()\nitems = []");
+    cppy3::Function add(L"counter.add", true);
+    cppy3::Function append(L"items.append", true);
+    REQUIRE(!add.rebound());
+    REQUIRE(!append.rebound());
+    PyObject *bound = add.callable();
+    REQUIRE(add(2).toLong() == 2);
+    REQUIRE(add.callable() == bound);
+    cppy3::exec("counter = Counter()");
+    REQUIRE(add.rebound());
+    REQUIRE(add(5).toLong() == 5);
+    append(1);
+    cppy3::exec("items = []");
+    REQUIRE(append.rebound());
+
+    REQUIRE_THROWS_AS(cppy3::Function(L"os.path.nonexistent"), cppy3::PythonException);
+    REQUIRE_THROWS_AS(cppy3::Function(L"os.sep"), cppy3::PythonException);
+    REQUIRE(!cppy3::error());
+  }
+
+  SECTION("utf-8 string api") {
+    cppy3::exec("import os, sys\nclass Greeter:\n  greeting = 'привет'\n  def __call__(self, name):\n    return self.greeting + ', ' + name");
+
+    const std::string name = "os.path.join";
+    REQUIRE(cppy3::lookupCallable(cppy3::getMainModule(), name).data() ==
+            cppy3::lookupCallable(cppy3::getMainModule(), L"os.path.join").data());
+    // string_view needs not be null terminated
+    const std::string_view dotted = std::string_view("os.path.basename_").substr(0, 16);
+    REQUIRE(cppy3::Function(dotted)(std::string("dir/file")).toUTF8String() == "file");
+    REQUIRE_THROWS_AS(cppy3::lookupObject(cppy3::getMainModule(), "os.nonexistent"), cppy3::PythonException);
+
+    const cppy3::Var greeter = cppy3::createClassInstance("Greeter");
+    std::string greeting;
+    cppy3::extract(cppy3::vectorcall(greeter, std::string("мир")), greeting);
+    REQUIRE(greeting == "привет, мир");
+    cppy3::exec("greetings = {'ru': 'привет'}");
+    REQUIRE(cppy3::Main().var(std::string("greetings")).var(std::string_view("ru")).toUTF8String() == "привет");
+
+    cppy3::appendToSysPath(std::vector<std::string>{"/cppy3/тест"});
+    cppy3::appendToSysPath(std::vector<std::string>{"/cppy3/тест"});
+    REQUIRE(cppy3::eval("sys.path.count('/cppy3/тест')").toLong() == 1);
+
+    try {
+      throw cppy3::PythonException(std::string("ошибка"));
+    } catch (const cppy3::PythonException& e) {
+      REQUIRE(e.info.reason == L"ошибка");
+      REQUIRE(std::string(e.what()).find("ошибка") != std::string::npos);
+    }
+    REQUIRE(!cppy3::error());
+  }
+
+  SECTION("numeric vector as buffer") {
+    // copy once
+    const std::vector<double> values = {1.5, 2.5, 3.5};
+    cppy3::Main().inject("copied", cppy3::Var::from(cppy3::convertBuffer(values)));
+    cppy3::exec("assert copied.format == 'd' and copied.tolist() == [1.5, 2.5, 3.5], copied.tolist()");
+    cppy3::exec("copied[0] = 0");
+    REQUIRE(values[0] == 1.5);
+
+    // shared with python
+    auto shared = std::make_shared<std::vector<int64_t>>(std::vector<int64_t>{1, 2, 3});
+    cppy3::Main().inject("shared", cppy3::Var::from(cppy3::convertBuffer(shared)));
+    cppy3::exec("shared[2] = 42");
+    REQUIRE((*shared)[2] == 42);
+
+    // python keeps data alive after C++ drops it
+    std::weak_ptr<std::vector<int64_t>> weak = shared;
+    shared.reset();
+    REQUIRE(!weak.expired());
+    cppy3::exec("assert sum(shared) == 45 and len(shared) == 3");
+    cppy3::exec("del shared");
+    REQUIRE(weak.expired());
+
+    cppy3::Main().inject("empty", cppy3::Var::from(cppy3::convertBuffer(std::vector<float>())));
+    cppy3::exec("assert len(empty) == 0 and empty.format == 'f'");
+  }
+
+  SECTION("n-dimensional buffer") {
+    // C++ owned, shared with python
+    cppy3::BufferArray<double> matrix({2, 3});
+    for (Py_ssize_t r = 0; r < 2; ++r)
+      for (Py_ssize_t c = 0; c < 3; ++c)
+        matrix(r, c) = r * 10 + c;
+    cppy3::Main().inject("matrix", cppy3::Var::from(cppy3::convert(matrix)));
+    cppy3::exec("assert matrix.shape == (2, 3) and matrix.strides == (24, 8) and matrix.format == 'd'");
+    cppy3::exec("assert matrix.tolist() == [[0, 1, 2], [10, 11, 12]], matrix.tolist()");
+    cppy3::exec("matrix[1, 2] = 42");
+    REQUIRE(matrix(1, 2) == 42);
+    cppy3::exec("import array, struct\n"
+                "flat = array.array('d', matrix.cast('B').cast('d'))\n"
+                "assert flat.tolist() == [0, 1, 2, 10, 11, 42]\n"
+                "assert struct.unpack_from('2d', matrix, 8) == (1, 2)");
+
+    // python keeps memory alive after C++ drops it
+    std::weak_ptr<void> weak = matrix.owner();
+    matrix = cppy3::BufferArray<double>();
+    REQUIRE(!weak.expired());
+    cppy3::exec("del matrix");
+    REQUIRE(weak.expired());
+
+    // strided view of C++ memory, transposed
+    std::vector<int32_t> values = {1, 2, 3, 4, 5, 6};
+    const cppy3::BufferArray<int32_t> transposed(values.data(), {3, 2}, std::shared_ptr<void>(), {4, 12});
+    REQUIRE(!transposed.contiguous());
+    REQUIRE(transposed(2, 1) == 6);
+    cppy3::Main().inject("transposed", cppy3::Var::from(cppy3::convert(transposed)));
+    cppy3::exec("assert transposed.tolist() == [[1, 4], [2, 5], [3, 6]] and not transposed.c_contiguous and transposed.f_contiguous");
+    cppy3::exec("assert transposed.tobytes() == struct.pack('6i', 1, 4, 2, 5, 3, 6)");
+    cppy3::exec("del transposed");
+
+    // pooled memory
+    cppy3::BufferPool pool;
+    {
+      const cppy3::BufferArray<float> frame({4, 4}, pool);
+      cppy3::Var view = cppy3::Var::from(cppy3::convert(frame));
+      REQUIRE(pool.stats().inUseBytes == 64);
+    }
+    REQUIRE(pool.stats().inUseBytes == 0);
+
+    // buffers exported by python viewed without copy
+    cppy3::BufferArray<int32_t> ints(cppy3::eval("array.array('i', [1, 2, 3])"));
+    REQUIRE(ints.ndim() == 1);
+    REQUIRE(ints.size() == 3);
+    REQUIRE(!ints.readonly());
+    cppy3::exec("ints = array.array('i', [7, 8, 9])");
+    ints = cppy3::BufferArray<int32_t>(cppy3::eval("ints"));
+    ints(1) = 42;
+    cppy3::exec("assert ints[1] == 42");
+    // exporter is locked against resizing meanwhile
+    REQUIRE_THROWS_AS(cppy3::exec("ints.append(1)"), cppy3::PythonException);
+    ints = cppy3::BufferArray<int32_t>();
+    cppy3::exec("ints.append(1)");
+
+    const cppy3::BufferArray<uint8_t> bytes(cppy3::eval("b'abc'"));
+    REQUIRE(bytes.readonly());
+    REQUIRE(bytes(2) == 'c');
+    cppy3::Main().inject("bytesView", cppy3::Var::from(cppy3::convert(bytes)));
+    cppy3::exec("assert bytesView.readonly and bytesView.tobytes() == b'abc'");
+
+    const cppy3::BufferArray<int16_t> grid(cppy3::eval("memoryview(bytearray(24)).cast('h', (3, 4))[::2]"));
+    REQUIRE(grid.shape() == std::vector<Py_ssize_t>({2, 4}));
+    REQUIRE(grid.strides() == std::vector<Py_ssize_t>({16, 2}));
+
+    REQUIRE_THROWS_AS(cppy3::BufferArray<double>(cppy3::eval("array.array('i', [1])")), cppy3::PythonException);
+    REQUIRE_THROWS_AS(cppy3::BufferArray<double>(cppy3::eval("42")), cppy3::PythonException);
+  }
+
+  SECTION("extract vectors") {
+    std::vector<double> doubles;
+    cppy3::extract(cppy3::eval("[1.0, 2.0, 3.0]"), doubles);
+    REQUIRE(doubles == std::vector<double>({1.0, 2.0, 3.0}));
+    cppy3::extract(cppy3::eval("(4.0, 5.0)"), doubles);
+    REQUIRE(doubles == std::vector<double>({4.0, 5.0}));
+
+    std::vector<int> ints;
+    cppy3::extract(cppy3::eval("range(3)"), ints);
+    REQUIRE(ints == std::vector<int>({0, 1, 2}));
+
+    // contiguous buffers of matching type are copied in bulk
+    std::vector<int64_t> int64s;
+    cppy3::extract(cppy3::eval("memoryview(__import__('array').array('q', [7, 8, 9]))"), int64s);
+    REQUIRE(int64s == std::vector<int64_t>({7, 8, 9}));
+    std::vector<float> floats;
+    cppy3::extract(cppy3::Var::from(cppy3::convertBuffer(std::vector<float>({0.5f, 1.5f}))), floats);
+    REQUIRE(floats == std::vector<float>({0.5f, 1.5f}));
+
+    std::vector<std::wstring> strings;
+    REQUIRE_THROWS_AS(cppy3::Main().getList(L"__name__", strings), cppy3::PythonException);
+    cppy3::extract(cppy3::eval("['a', 'b']"), strings);
+    REQUIRE(strings == std::vector<std::wstring>({L"a", L"b"}));
+
+    REQUIRE_THROWS_AS(cppy3::extract(cppy3::eval("42"), doubles), cppy3::PythonException);
+    REQUIRE_THROWS_AS(cppy3::extract(cppy3::eval("[1.0, 'x']"), doubles), cppy3::PythonException);
+    // overflow is reported, not left pending
+    REQUIRE_THROWS_AS(cppy3::extract(cppy3::eval("[1, 2 ** 70]"), int64s), cppy3::PythonException);
+    REQUIRE_THROWS_AS(cppy3::extract(cppy3::eval("[-2 ** 64]"), ints), cppy3::PythonException);
+    REQUIRE(!cppy3::error());
+  }
+
   SECTION("python -> c++ exception forwarding") {
     try {
       // throw excepton in python
@@ -109,10 +539,23 @@ TEST_CASE( "cppy3: Embedding Python into C++ code", "main funcs" ) {
       REQUIRE(e.info.type == L"<class 'Exception'>");
       REQUIRE(e.info.reason == L"test-exception");
       REQUIRE(e.info.trace.size() > 0);
-      REQUIRE(std::string(e.what()).size() > 0);
+      REQUIRE(std::string(e.what()).find("File \"<string>\", line 1") != std::string::npos);
+      // copies share formatted traceback
+      const cppy3::PythonException copy(e);
+      REQUIRE(&copy.info.trace[0] == &e.info.trace[0]);
     }
     // exception has been poped from python layer
     REQUIRE(!cppy3::error());
+
+    // formatting traceback on demand keeps pending python error intact
+    PyObject *mainDict = cppy3::getMainDict();
+    REQUIRE(cppy3::Var::from(PyRun_String("1 / 0", Py_eval_input, mainDict, mainDict)).null());
+    const cppy3::PyExceptionData pending = cppy3::getErrorObject(false);
+    REQUIRE(pending.type == L"<class 'ZeroDivisionError'>");
+    REQUIRE(pending.trace.size() == 1);
+    REQUIRE(cppy3::error());
+    cppy3::getErrorObject(true);
+    REQUIRE(!cppy3::error());
   }
 
 #if CPPY3_BUILT_WITH_NUMPY
@@ -144,6 +587,255 @@ TEST_CASE( "cppy3: Embedding Python into C++ code", "main funcs" ) {
     cppy3::exec("b[0] = 100500");
     REQUIRE(b(0, 0) == 100500);
     REQUIRE(cData[0] == 100500);
+
+    // extract ndarray into vector
+    std::vector<double> values;
+    cppy3::extract(a, values);
+    REQUIRE(values == std::vector<double>({3.14, 42}));
+    cppy3::extract(cppy3::eval("numpy.arange(6, dtype=numpy.float64)[::2]"), values);
+    REQUIRE(values == std::vector<double>({0, 2, 4}));
+
+    // N-d arrays: time x instrument x feature
+    cppy3::NDArray<double> tensor({4, 3, 2});
+    REQUIRE(tensor.nd() == 3);
+    REQUIRE(tensor.shape() == std::vector<npy_intp>({4, 3, 2}));
+    REQUIRE(tensor.strides() == std::vector<npy_intp>({48, 16, 8}));
+    for (npy_intp i = 0; i < tensor.size(); ++i) {
+      tensor.getData()[i] = double(i);
+    }
+    REQUIRE(tensor(2, 1, 1) == 2 * 6 + 1 * 2 + 1);
+    const cppy3::NDView<double> v = tensor.view();
+    REQUIRE(v.contiguous());
+    REQUIRE(v[2].ndim == 2);
+    REQUIRE(v[2](1, 1) == tensor(2, 1, 1));
+    REQUIRE(v[3][2](0) == 3 * 6 + 2 * 2);
+    cppy3::Main().inject("tensor", tensor);
+    cppy3::exec("assert tensor.shape == (4, 3, 2) and tensor[2, 1, 1] == 15");
+
+    // arrays created in python, strided
+    cppy3::NDArray<double> transposed(cppy3::eval("numpy.arange(24, dtype=numpy.float64).reshape(2, 3, 4).transpose(2, 0, 1)"));
+    REQUIRE(transposed.shape() == std::vector<npy_intp>({4, 2, 3}));
+    REQUIRE(!transposed.view().contiguous());
+    REQUIRE(transposed(3, 1, 2) == 1 * 12 + 2 * 4 + 3);
+    REQUIRE_THROWS_AS(cppy3::NDArray<double>(cppy3::eval("numpy.arange(3)")), cppy3::PythonException);
+
+    // copy and strided wrap of C++ data: every second column of 2 x 4 matrix
+    const double matrix[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    cppy3::NDArray<double> copied(matrix, {2, 4});
+    REQUIRE(copied(1, 3) == 7);
+    double data[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    cppy3::NDArray<double> columns;
+    columns.wrap(data, {2, 2}, {4 * sizeof(double), 2 * sizeof(double)});
+    REQUIRE(columns(1, 1) == 6);
+    cppy3::Main().inject("columns", columns);
+    cppy3::exec("columns[0, 1] = -1; assert not columns.flags.c_contiguous");
+    REQUIRE(data[2] == -1);
+
+    // zero-copy wraps with ownership: python views outlive C++ scope
+    {
+      bool released = false;
+      double *owned = new double[3]{1, 2, 3};
+      {
+        cppy3::NDArray<double> shared;
+        shared.wrap(owned, {3}, std::shared_ptr<void>(owned, [&released](void *p) { delete[] static_cast<double *>(p); released = true; }));
+        cppy3::Main().inject("shared", shared);
+      }
+      cppy3::exec("tail = shared[1:]; del shared");
+      REQUIRE(!released);
+      REQUIRE(cppy3::eval("tail.tolist()").toUTF8String() == "[2.0, 3.0]");
+      cppy3::exec("del tail");
+      REQUIRE(released);
+
+      cppy3::NDArray<int64_t> adopted;
+      adopted.wrap(std::vector<int64_t>({5, 6, 7, 8}), {2, 2});
+      REQUIRE(adopted(1, 0) == 7);
+      cppy3::Main().inject("adopted", adopted);
+      cppy3::exec("assert adopted.base is not None and adopted.sum() == 26; del adopted");
+
+      double line[3] = {1, 2, 3};
+      cppy3::NDArray<double> wrapped1d;
+      wrapped1d.wrap(line, 3);
+      wrapped1d(2) = 30;
+      REQUIRE(line[2] == 30);
+    }
+
+    // pooled backing memory, returned with last view
+    {
+      cppy3::BufferPool::Options options;
+      options.alignment = 128;
+      std::shared_ptr<cppy3::BufferPool> pool = std::make_shared<cppy3::BufferPool>(options);
+      REQUIRE(pool->sizeClass(1) == 64);
+      REQUIRE(pool->sizeClass(100) == 112);
+      REQUIRE(pool->sizeClass(4096) == 4096);
+      REQUIRE(pool->sizeClass(4097) == 5120);
+      cppy3::NDArray<float> frame;
+      frame.create({100, 10}, *pool, true);
+      REQUIRE(reinterpret_cast<uintptr_t>(frame.getData()) % 128 == 0);
+      REQUIRE(frame(99, 9) == 0);
+      cppy3::Main().inject("frame", frame);
+      frame.create({100, 10}, *pool);
+      REQUIRE(pool->stats().reused == 0);
+      cppy3::exec("del frame");
+      cppy3::setNDArrayPool(pool);
+      frame.create({100, 10});
+      cppy3::setNDArrayPool(nullptr);
+      cppy3::BufferPool::Stats stats = pool->stats();
+      REQUIRE(stats.requests == 3);
+      REQUIRE(stats.reused == 1);
+      REQUIRE(stats.systemAllocations == 2);
+      REQUIRE(stats.reuseRate() == Approx(1.0 / 3));
+      REQUIRE(stats.inUseBytes == pool->sizeClass(4000));
+      REQUIRE(stats.cachedBytes == pool->sizeClass(4000));
+      frame.create({1});
+      stats = pool->stats();
+      REQUIRE(stats.inUseBytes == 0);
+      REQUIRE(stats.cachedBytes == 2 * pool->sizeClass(4000));
+      pool->trim();
+      REQUIRE(pool->stats().cachedBytes == 0);
+      // blocks outlive pool
+      std::shared_ptr<void> huge = pool->allocate(3 << 20);
+      REQUIRE(pool->sizeClass(3 << 20) % (2 << 20) == 0);
+      frame.create({100, 10}, *pool);
+      frame(99, 9) = 5;
+      cppy3::Main().inject("frame", frame);
+      frame.create({1});
+      pool.reset();
+      std::memset(huge.get(), 1, 3 << 20);
+      huge.reset();
+      cppy3::exec("assert frame[99, 9] == 5\ndel frame");
+    }
+
+    // dtypes without widening
+    cppy3::NDArray<float> features;
+    features.create({2, 3}, true);
+    cppy3::NDArray<int64_t> timestamps({2});
+    timestamps(1) = 1700000000000000000LL;
+    cppy3::NDArray<std::complex<double>> spectrum({1});
+    spectrum(0) = std::complex<double>(1, -2);
+    cppy3::NDArray<bool> mask;
+    mask.create({2}, true);
+    mask(1) = true;
+    cppy3::NDArray<cppy3::float16> half({1});
+    half(0).bits = 0x3C00;
+    cppy3::NDArray<uint8_t> bytes;
+    bytes.create({3}, true);
+    cppy3::Main().inject("features", features);
+    cppy3::Main().inject("timestamps", timestamps);
+    cppy3::Main().inject("spectrum", spectrum);
+    cppy3::Main().inject("mask", mask);
+    cppy3::Main().inject("half", half);
+    cppy3::Main().inject("bytes_", bytes);
+    cppy3::exec("assert features.dtype == numpy.float32 and features.sum() == 0\n"
+                "assert timestamps.dtype == numpy.int64 and timestamps[1] == 1700000000000000000\n"
+                "assert spectrum.dtype == numpy.complex128 and spectrum[0] == 1 - 2j\n"
+                "assert mask.dtype == numpy.bool_ and list(mask) == [False, True]\n"
+                "assert half.dtype == numpy.float16 and half[0] == 1.0\n"
+                "assert bytes_.dtype == numpy.uint8\n");
+    REQUIRE_THROWS_AS(cppy3::NDArray<float>(cppy3::eval("timestamps")), cppy3::PythonException);
+    REQUIRE(cppy3::NDArray<int64_t>(cppy3::eval("numpy.zeros(3, dtype='i8')")).size() == 3);
+
+    // records from C++ structs
+    cppy3::NDArray<TestQuote> quotes;
+    quotes.create({3}, true);
+    quotes(1).bid = 1.5f;
+    quotes(1).sizes[1] = 7;
+    cppy3::Main().inject("quotes", quotes);
+    cppy3::exec("assert quotes.dtype.names == ('time', 'bid', 'ask', 'sizes')\n"
+                "assert quotes['bid'][1] == 1.5 and quotes['sizes'][1][1] == 7\n"
+                "quotes[2]['ask'] = 2.25\n");
+    REQUIRE(cppy3::eval("quotes.dtype.itemsize").toLong() == long(sizeof(TestQuote)));
+    REQUIRE(quotes(2).ask == 2.25f);
+    cppy3::NDArray<TestQuote> fromPython(cppy3::eval("numpy.zeros(2, dtype=quotes.dtype)"));
+    REQUIRE(fromPython.size() == 2);
+
+    // copy out of any layout into C order
+    std::vector<double> out(24);
+    transposed.copyTo(out.data());
+    cppy3::Main().inject("out", cppy3::Var::from(cppy3::convert(out)));
+    cppy3::exec("assert list(out) == list(numpy.arange(24.0).reshape(2, 3, 4).transpose(2, 0, 1).ravel())");
+
+    // copy in of strided C++ block: every second column of 2 x 4 matrix
+    const npy_intp blockShape[2] = {2, 2};
+    const npy_intp blockStrides[2] = {4 * sizeof(double), 2 * sizeof(double)};
+    cppy3::NDArray<double> block;
+    block.copy(cppy3::NDView<double>{data, 2, blockShape, blockStrides});
+    REQUIRE(block.strides() == std::vector<npy_intp>({16, 8}));
+    REQUIRE(block(1, 1) == data[1 * 4 + 2]);
+
+    // parallel copies match serial ones
+    cppy3::setCopyThreads(4, 64);
+    std::vector<double> big(10000);
+    for (size_t i = 0; i < big.size(); ++i) {
+      big[i] = double(i);
+    }
+    cppy3::NDArray<double> bigArray(big.data(), {100, 100});
+    cppy3::Main().inject("bigArray", bigArray);
+    cppy3::NDArray<double> bigTransposed(cppy3::eval("bigArray.T"));
+    std::vector<double> bigOut(big.size());
+    bigTransposed.copyTo(bigOut.data());
+    cppy3::NDArray<TestQuote> quotesCopy;
+    quotesCopy.copy(quotes.view());
+    cppy3::setCopyThreads(1);
+    REQUIRE(bigArray(42, 17) == 4217);
+    REQUIRE(bigOut[17 * 100 + 42] == 4217);
+    REQUIRE(quotesCopy(1).sizes[1] == 7);
+
+    // buffer arrays are consumed by numpy without copy
+    const cppy3::BufferArray<float> plain({2, 2});
+    cppy3::Main().inject("plain", cppy3::Var::from(cppy3::convert(plain)));
+    cppy3::exec("plainArray = numpy.asarray(plain)\nplainArray[1, 1] = 3\nassert plainArray.dtype == numpy.float32");
+    REQUIRE(plain(1, 1) == 3);
+    const cppy3::BufferArray<double> fromNumpy(cppy3::eval("numpy.arange(6.0).reshape(2, 3).T"));
+    REQUIRE(fromNumpy(2, 1) == 5);
+
+    // DLPack tensors of python objects, zero-copy
+    cppy3::exec("source = numpy.arange(6, dtype=numpy.float32).reshape(2, 3)");
+    cppy3::NDArray<float> imported;
+    imported.fromDLPack(cppy3::eval("source.T"));
+    REQUIRE(imported.shape() == std::vector<npy_intp>({3, 2}));
+    REQUIRE(imported(2, 1) == 5);
+    imported(0, 1) = 42;
+    cppy3::exec("assert source[1, 0] == 42");
+    const cppy3::Var capsule = cppy3::eval("source.__dlpack__()");
+    imported.fromDLPack(capsule);
+    REQUIRE(imported(1, 2) == 5);
+    // capsule is consumed once
+    REQUIRE_THROWS_AS(imported.fromDLPack(capsule), cppy3::PythonException);
+    REQUIRE_THROWS_AS(cppy3::NDArray<double>().fromDLPack(cppy3::eval("source")), cppy3::PythonException);
+    REQUIRE_THROWS_AS(imported.fromDLPack(cppy3::eval("42")), cppy3::PythonException);
+
+    // tensors for C++ libraries keep array alive until deleter
+    DLManagedTensor *exported = NULL;
+    {
+      cppy3::NDArray<float> original(cppy3::eval("source.copy()"));
+      exported = original.toDLPack();
+    }
+    REQUIRE(exported->dl_tensor.ndim == 2);
+    REQUIRE(exported->dl_tensor.dtype.code == kDLFloat);
+    REQUIRE(exported->dl_tensor.dtype.bits == 32);
+    REQUIRE(exported->dl_tensor.strides[0] == 3);
+    REQUIRE(static_cast<float *>(exported->dl_tensor.data)[5] == 5);
+    // round trip, C++ tensor handed to python consumer
+    cppy3::NDArray<float> roundTrip;
+    roundTrip.fromDLPack(exported);
+    cppy3::Main().inject("roundTrip", roundTrip);
+    cppy3::exec("assert roundTrip.tolist() == [[0, 1, 2], [42, 4, 5]], roundTrip.tolist()");
+    cppy3::Main().inject("tensorCapsule", cppy3::Var::from(cppy3::dlpackCapsule(roundTrip.toDLPack())));
+    cppy3::exec("class Producer:\n"
+                "  def __dlpack__(self, **kwargs): return tensorCapsule\n"
+                "  def __dlpack_device__(self): return (1, 0)\n"
+                "consumed = numpy.from_dlpack(Producer())\n"
+                "del tensorCapsule, Producer");
+    roundTrip(0, 0) = 7;
+    cppy3::exec("assert consumed[0, 0] == 7 and consumed.shape == (2, 3)");
+    // unconsumed capsule calls deleter, which lets exported array go
+    cppy3::exec("import weakref\nexportedSource = numpy.ones(3)\nexportedRef = weakref.ref(exportedSource)");
+    {
+      cppy3::NDArray<double> exportedArray(cppy3::eval("exportedSource"));
+      cppy3::Main().inject("unused", cppy3::Var::from(cppy3::dlpackCapsule(exportedArray.toDLPack())));
+    }
+    cppy3::exec("del exportedSource\nassert exportedRef() is not None");
+    cppy3::exec("del unused\nassert exportedRef() is None");
   }
 #endif
 
@@ -193,4 +885,384 @@ t.start()
     }
   }
 
+  SECTION("concurrent access from threads") {
+    cppy3::exec("import sys\nshared = []\nsavedPath = list(sys.path)");
+    cppy3::List shared(cppy3::lookupObject(cppy3::getMainModule(), "shared"));
+    std::vector<std::thread> threads;
+    {
+      cppy3::ScopedGILRelease gilRelease;
+      for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&shared, t]() {
+          cppy3::GILLocker locker;
+          for (int i = 0; i < 1000; ++i) {
+            shared.append(cppy3::Var::from(cppy3::convert(t * 1000 + i)));
+            shared[i / 2].toLong();
+            cppy3::appendToSysPath(std::vector<std::string>{"/cppy3/thread" + std::to_string(t)});
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+    }
+    REQUIRE(shared.size() == 4000);
+    std::vector<long> values;
+    cppy3::extract(shared, values);
+    std::sort(values.begin(), values.end());
+    for (long i = 0; i < 4000; ++i) {
+      REQUIRE(values[i] == i);
+    }
+    const long added = cppy3::eval("len([p for p in sys.path if p.startswith('/cppy3/thread')])").toLong();
+    cppy3::exec("sys.path[:] = savedPath");
+    REQUIRE(added == 4);
+    REQUIRE(cppy3::eval("len([p for p in sys.path if p.startswith('/cppy3/thread')])").toLong() == 0);
+  }
+
+  SECTION("export c++ functions") {
+    int calls = 0;
+    cppy3::Module("native", "exported from tests")
+        .def("add", [](long a, double b) { return a + b; }, {"a", "b"}, "Sum of a and b.")
+        .def("greet", [](const std::string &name, bool loud) { return (loud ? "HELLO " : "hello ") + name; }, {"name", "loud"})
+        .def("total", [](const std::vector<long> &values) { long s = 0; for (long v : values) s += v; return s; })
+        .def("count", [&calls]() { ++calls; })
+        .def("identity", [](cppy3::Var o) { return o; }, {"o"})
+        .def("fail", [](int code) -> int { throw std::runtime_error("failed with " + std::to_string(code)); })
+        .def("narrow", [](short s, unsigned u, uint64_t big) { return s + u + big; }, {"s", "u", "big"})
+        .install();
+
+    cppy3::exec("import native");
+    REQUIRE(cppy3::eval("native.add(2, 0.5)").toDouble() == 2.5);
+    REQUIRE(cppy3::eval("native.add(b=0.25, a=1)").toDouble() == 1.25);
+    REQUIRE(cppy3::eval("native.greet('cppy3', loud=True)").toUTF8String() == "HELLO cppy3");
+    REQUIRE(cppy3::eval("native.total([1, 2, 3])").toLong() == 6);
+    cppy3::exec("for i in range(5): native.count()");
+    REQUIRE(calls == 5);
+    REQUIRE(cppy3::eval("native.identity(o=native) is native").toLong() == 1);
+    REQUIRE(cppy3::eval("str(__import__('inspect').signature(native.add))").toUTF8String() == "(a, b)");
+    REQUIRE(cppy3::eval("native.__doc__").toUTF8String() == "exported from tests");
+
+    auto raises = [](const char *expression, const std::wstring &type, const std::string &text) {
+      try {
+        cppy3::eval(expression);
+        REQUIRE(false);  // unreachable code, expect an exception
+      } catch (const cppy3::PythonException& e) {
+        REQUIRE(e.info.type == type);
+        REQUIRE(cppy3::WideToUTF8(e.info.reason).find(text) != std::string::npos);
+      }
+    };
+    raises("native.add(1)", L"<class 'TypeError'>", "missing required argument 'b'");
+    raises("native.add(1, 2, 3)", L"<class 'TypeError'>", "takes 2 positional arguments");
+    raises("native.add(1, a=2)", L"<class 'TypeError'>", "multiple values for argument 'a'");
+    raises("native.add(1, c=2)", L"<class 'TypeError'>", "unexpected keyword argument 'c'");
+    raises("native.add('x', 2)", L"<class 'TypeError'>", "argument 'a'");
+    raises("native.total(x=[1])", L"<class 'TypeError'>", "unexpected keyword argument 'x'");
+    raises("native.fail(7)", L"<class 'RuntimeError'>", "failed with 7");
+    // integers must fit parameter type
+    REQUIRE(cppy3::eval("native.narrow(-1, 2, 2 ** 64 - 4)").toString() == L"18446744073709551613");
+    raises("native.narrow(70000, 0, 0)", L"<class 'TypeError'>", "argument 's': <class 'OverflowError'>");
+    raises("native.narrow(0, -1, 0)", L"<class 'TypeError'>", "argument 'u': <class 'OverflowError'>");
+    raises("native.narrow(0, 2 ** 32, 0)", L"<class 'TypeError'>", "argument 'u': <class 'OverflowError'>");
+    raises("native.narrow(0, 0, 2 ** 64)", L"<class 'TypeError'>", "argument 'big': <class 'OverflowError'>");
+    REQUIRE(!cppy3::error());
+  }
+
+  SECTION("export c++ classes") {
+    struct Order {
+      long id = 0;
+      double price = 0;
+      std::string symbol;
+      std::vector<double> fills;
+    };
+    const cppy3::Class<Order> order = cppy3::Class<Order>("Order", "Limit order.")
+        .readonly("id", &Order::id)
+        .field("price", &Order::price, "Limit price.")
+        .field("symbol", &Order::symbol)
+        .field("fills", &Order::fills)
+        .method("notional", [](const Order &o, long qty) { return o.price * qty; }, {"qty"})
+        .method("fill", [](Order &o, double price) { o.fills.push_back(price); });
+    cppy3::Module("market").type(order).install();
+    cppy3::exec("import market");
+
+    // created in python, fields initialized by keyword
+    cppy3::exec("o = market.Order(price=2.5, symbol='EURUSD')");
+    REQUIRE(cppy3::eval("o.price").toDouble() == 2.5);
+    REQUIRE(cppy3::eval("o.symbol").toUTF8String() == "EURUSD");
+    REQUIRE(cppy3::eval("o.notional(qty=4)").toDouble() == 10);
+    cppy3::exec("o.fill(2.25); o.fill(2.5)");
+    REQUIRE(cppy3::eval("o.fills == [2.25, 2.5]").toLong() == 1);
+    REQUIRE(cppy3::eval("type(o).__module__ == 'market' and type(o).__name__ == 'Order'").toLong() == 1);
+    REQUIRE(cppy3::eval("market.Order.price.__doc__").toUTF8String() == "Limit price.");
+    const Order *fromPython = order.get(cppy3::eval("o"));
+    REQUIRE(fromPython);
+    REQUIRE(fromPython->fills.size() == 2);
+    REQUIRE(order.get(cppy3::eval("1")) == NULL);
+
+    // copy owned by python
+    Order source;
+    source.id = 7;
+    source.price = 100.5;
+    cppy3::Main().inject("a", order.instance(source));
+    cppy3::exec("a.price = 101");
+    REQUIRE(source.price == 100.5);
+    REQUIRE(order.get(cppy3::eval("a"))->price == 101);
+
+    // zero-copy views
+    cppy3::Main().inject("b", order.view(source));
+    cppy3::exec("b.price = 99.5; b.symbol = 'GBPUSD'");
+    REQUIRE(source.price == 99.5);
+    REQUIRE(source.symbol == "GBPUSD");
+    source.price = 98;
+    REQUIRE(cppy3::eval("b.price").toDouble() == 98);
+    cppy3::exec("del b");
+
+    std::shared_ptr<Order> shared = std::make_shared<Order>();
+    cppy3::Main().inject("c", order.view(shared));
+    REQUIRE(shared.use_count() == 2);
+    cppy3::exec("c.price = 1.5");
+    REQUIRE(shared->price == 1.5);
+    cppy3::exec("del c");
+    REQUIRE(shared.use_count() == 1);
+
+    auto raises = [](const char *script, const std::wstring &type, const std::string &text) {
+      try {
+        cppy3::exec(script);
+        REQUIRE(false);  // unreachable code, expect an exception
+      } catch (const cppy3::PythonException& e) {
+        REQUIRE(e.info.type == type);
+        REQUIRE(cppy3::WideToUTF8(e.info.reason).find(text) != std::string::npos);
+      }
+    };
+    // fixed layout, no instance __dict__
+    raises("a.volume = 1", L"<class 'AttributeError'>", "volume");
+    raises("a.id = 1", L"<class 'AttributeError'>", "id");
+    raises("a.price = 'x'", L"<class 'TypeError'>", "attribute 'price'");
+    raises("market.Order(1)", L"<class 'TypeError'>", "keyword arguments only");
+    raises("market.Order.notional(1, 2)", L"<class 'TypeError'>", "requires instance");
+    REQUIRE_THROWS_AS(cppy3::Class<Order>(order).field("size", &Order::id), cppy3::PythonException);
+    REQUIRE(!cppy3::error());
+  }
+
+  SECTION("thread attachment") {
+    // Catch2 assertions are not thread safe, worker records what it saw and asserts run after join
+    struct Observed {
+      bool detachedBefore = false;
+      bool attached = false;
+      bool unlockedWhileAttached = false;
+      int sameStateLocks = 0;
+      int evaluated = 0;
+      int nestedReused = 0;
+      bool unlockedAfterLocks = false;
+      bool detachedAfter = false;
+      bool fallbackLocked = false;
+      std::exception_ptr error;
+    } observed;
+    std::thread worker;
+    {
+      cppy3::ScopedGILRelease gilRelease;
+      worker = std::thread([&observed]() {
+        try {
+          observed.detachedBefore = cppy3::ThreadAttachment::current() == NULL;
+          {
+            cppy3::ThreadAttachment attachment;
+            PyThreadState *state = cppy3::ThreadAttachment::current();
+            observed.attached = state != NULL;
+            observed.unlockedWhileAttached = !cppy3::GILLocker::isLocked();
+            for (int i = 0; i < 3; ++i) {
+              // same thread state is reused by every lock
+              cppy3::GILLocker locker;
+              observed.sameStateLocks += cppy3::attachedThreadState() == state;
+              observed.evaluated += cppy3::eval("1 + 1").toLong() == 2;
+              cppy3::ThreadAttachment nested;
+              observed.nestedReused += cppy3::ThreadAttachment::current() == state;
+            }
+            observed.unlockedAfterLocks = !cppy3::GILLocker::isLocked();
+          }
+          observed.detachedAfter = cppy3::ThreadAttachment::current() == NULL;
+          // PyGILState fallback still works
+          cppy3::GILLocker locker;
+          observed.fallbackLocked = cppy3::GILLocker::isLocked();
+        } catch (...) {
+          observed.error = std::current_exception();
+        }
+      });
+      worker.join();
+    }
+    REQUIRE(cppy3::GILLocker::isLocked());
+    REQUIRE(!observed.error);
+    REQUIRE(observed.detachedBefore);
+    REQUIRE(observed.attached);
+    REQUIRE(observed.unlockedWhileAttached);
+    REQUIRE(observed.sameStateLocks == 3);
+    REQUIRE(observed.evaluated == 3);
+    REQUIRE(observed.nestedReused == 3);
+    REQUIRE(observed.unlockedAfterLocks);
+    REQUIRE(observed.detachedAfter);
+    REQUIRE(observed.fallbackLocked);
+  }
+
+  SECTION("gil statistics") {
+    cppy3::GILHistogram histogram;
+    histogram.add(0);
+    histogram.add(1000);
+    histogram.add(1000);
+    REQUIRE(histogram.count == 3);
+    REQUIRE(histogram.buckets[0] == 1);
+    REQUIRE(histogram.buckets[10] == 2);
+    REQUIRE(histogram.quantile(0.5) == 1000);
+
+    cppy3::resetGILStats();
+    std::thread worker;
+    {
+      cppy3::ScopedGILRelease gilRelease;
+      worker = std::thread([]() {
+        for (int i = 0; i < 5; ++i) {
+          cppy3::GILLocker locker;
+          cppy3::exec("x = 1");
+        }
+      });
+      worker.join();
+    }
+    const cppy3::GILStats stats = cppy3::gilStats();
+    REQUIRE(stats.toJSON().find("\"enabled\":") != std::string::npos);
+#if CPPY3_GIL_STATS
+    REQUIRE(stats.enabled);
+    const auto site = std::find_if(stats.sites.begin(), stats.sites.end(), [](const cppy3::GILSiteStats& s) {
+      return s.kind == cppy3::GILLockKind::LOCKER && s.file.find("tests.cpp") != std::string::npos;
+    });
+    REQUIRE(site != stats.sites.end());
+    REQUIRE(site->wait.count == 5);
+    REQUIRE(site->hold.count == 5);
+    // reacquisition after the release above
+    REQUIRE(std::any_of(stats.sites.begin(), stats.sites.end(), [](const cppy3::GILSiteStats& s) {
+      return s.kind == cppy3::GILLockKind::SCOPED_RELEASE && s.file.find("tests.cpp") != std::string::npos;
+    }));
+    REQUIRE(stats.threads.size() >= 2);
+    // joined worker is folded into exited threads
+    REQUIRE(std::any_of(stats.threads.begin(), stats.threads.end(), [](const cppy3::GILThreadStats& t) {
+      return t.thread == "exited threads" && t.acquisitions >= 5;
+    }));
+    const std::string text = stats.toText();
+    REQUIRE(text.find("GILLocker") != std::string::npos);
+    REQUIRE(text.find(site->file + ":" + std::to_string(site->line)) != std::string::npos);
+    cppy3::Main().inject("statsJSON", cppy3::Var::from(cppy3::convert(std::string_view(stats.toJSON()))));
+    cppy3::exec("import json\n"
+                "parsed = json.loads(statsJSON)\n"
+                "assert parsed['enabled'] and parsed['wait']['count'] >= 5\n"
+                "assert any(s['kind'] == 'GILLocker' and s['file'].endswith('tests.cpp') for s in parsed['sites'])");
+#else
+    REQUIRE(!stats.enabled);
+    REQUIRE(stats.sites.empty());
+#endif
+  }
+
+  SECTION("executor") {
+    cppy3::Executor::Options options;
+    options.threads = 3;
+    options.setup = "def square(x):\n  return x * x\n";
+    {
+      cppy3::Executor executor(options);
+      REQUIRE(executor.size() == 3);
+
+      // queued while main thread holds GIL, drained in batches
+      std::vector<cppy3::Future<long>> results;
+      for (long i = 0; i < 200; ++i) {
+        results.push_back(executor.call<long>("square", i));
+      }
+      for (long i = 0; i < 200; ++i) {
+        REQUIRE(results[i].get() == i * i);
+      }
+      const cppy3::Executor::Stats stats = executor.stats();
+      REQUIRE(stats.tasks == 200);
+      REQUIRE(stats.batches < stats.tasks);
+
+      // exceptions are forwarded
+      try {
+        executor.submit([]() { cppy3::exec("raise KeyError('in task')"); }).get();
+        REQUIRE(false);  // unreachable code, expect an exception
+      } catch (const cppy3::PythonException& e) {
+        REQUIRE(e.info.type == L"<class 'KeyError'>");
+      }
+
+      // tasks pinned to one worker are spread by stealing
+      std::vector<cppy3::Future<void>> sleeps;
+      for (int i = 0; i < 6; ++i) {
+        sleeps.push_back(executor.submit(0, []() { cppy3::ScopedGILRelease release; std::this_thread::sleep_for(std::chrono::milliseconds(20)); }));
+      }
+      for (auto &s : sleeps) {
+        s.get();
+      }
+      REQUIRE(executor.stats().steals > 0);
+    }
+    REQUIRE(cppy3::GILLocker::isLocked());
+    REQUIRE(!cppy3::error());
+
+#if CPPY3_HAVE_SUBINTERPRETERS
+    options.ownGIL = true;
+    {
+      cppy3::Executor executor(options);
+      std::vector<cppy3::Future<long>> results;
+      for (long i = 0; i < 20; ++i) {
+        results.push_back(executor.call<long>("square", i));
+      }
+      for (long i = 0; i < 20; ++i) {
+        REQUIRE(results[i].get() == i * i);
+      }
+    }
+    REQUIRE(cppy3::GILLocker::isLocked());
+#endif
+  }
+
+#if CPPY3_HAVE_SUBINTERPRETERS
+  SECTION("sub-interpreter pool") {
+    cppy3::exec("main_only = True");
+    {
+      cppy3::SubInterpreterPool pool(2);
+      REQUIRE(pool.size() == 2);
+      REQUIRE(cppy3::GILLocker::isLocked());
+
+      pool.execAll("def square(x):\n  return x * x\ncounter = 0\ndef count():\n  global counter\n  counter += 1\n  return counter");
+      REQUIRE(pool.call<long>(0, "square", 7).get() == 49);
+
+      // interpreters are isolated from each other and from main one
+      pool.call<void>(0, "count").get();
+      REQUIRE(pool.call<long>(0, "count").get() == 2);
+      REQUIRE(pool.call<long>(1, "count").get() == 1);
+      REQUIRE_THROWS_AS(pool.exec(1, "main_only").get(), cppy3::PythonException);
+      REQUIRE_THROWS_AS(cppy3::eval("square"), cppy3::PythonException);
+
+      // cppy3 api works inside tasks
+      auto name = pool.submit(1, []() {
+        std::string value;
+        cppy3::extract(cppy3::eval("__name__"), value);
+        return value;
+      });
+      REQUIRE(name.get() == "__main__");
+
+      // exceptions come back with formatted traceback
+      try {
+        pool.exec(1, "def fail():\n  raise ValueError('sub-error')\nfail()").get();
+        REQUIRE(false);  // unreachable code, expect an exception
+      } catch (const cppy3::PythonException& e) {
+        REQUIRE(e.info.type == L"<class 'ValueError'>");
+        REQUIRE(e.info.reason == L"sub-error");
+        REQUIRE(e.info.trace.size() == 2);
+        REQUIRE(std::string(e.what()).find("in fail") != std::string::npos);
+      }
+
+      // round-robin dispatch in parallel
+      std::vector<cppy3::Future<long>> results;
+      for (int i = 0; i < 8; ++i) {
+        results.push_back(pool.submit([i]() { return cppy3::eval(("sum(range(" + std::to_string(i * 1000) + "))").c_str()).toLong(); }));
+      }
+      for (int i = 0; i < 8; ++i) {
+        REQUIRE(results[i].get() == long(i * 1000) * (i * 1000 - 1) / 2);
+      }
+    }
+    // main interpreter is intact
+    REQUIRE(cppy3::GILLocker::isLocked());
+    REQUIRE(cppy3::eval("main_only").toLong() == 1);
+    REQUIRE(!cppy3::error());
+  }
+#endif
+
 }